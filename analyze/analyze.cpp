@@ -0,0 +1,393 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <sys/stat.h>
+#include "../determine_2/checker.h"
+
+using namespace std;
+
+// 调度结果分析: 代替 dataAnalysis.ipynb 里 pandas 的 read_csv + merge + to_csv + hist
+// 每个数据集读一遍 flow.txt、port.txt、result.txt, 结果按流 id 经稠密下标数组接到流上,
+// 同时逐条交给 determine_2 的检查核心 (或 determine_1 的规则), 得到每条结果是否被丢弃;
+// 检查器拒绝结果时照样输出, 拒绝的位置和原因写到标准错误, 输出:
+//   flows.zan     : 每个流一行的列存文件, 列为 id,bandwidth,startTime,sendTime,port,time,wait,dropped
+//                   文件头 "ZAN1" | uint32 行数 | uint32 列数 | 每列 16 字节列名 | 之后每列 行数 个 int32
+//                   没有结果的流 port、time、wait 为 -1; wait = 发送时间 - 进入设备时间
+//   by_start.csv  : 按进入设备时间分组
+//   by_port.csv   : 按结果中的端口分组
+//                   两者的列为 分组,flows,dropped,bandwidth_mean,bandwidth_max,sendTime_mean,sendTime_max,
+//                   wait_mean,wait_p50,wait_p90,wait_max (wait 只统计没有被丢弃的流), by_port 另有端口带宽和
+//                   未丢弃流的 带宽 * 发送所需时间 之和 (work)
+//   send_hist.csv : startTime,sendTime,count, 每个进入时间的发送所需时间分布 (notebook 里的 hist)
+// numpy 读取 flows.zan:
+//   rows, cols = np.frombuffer(raw, '<u4', 2, 4)
+//   names = [raw[12 + 16 * i:28 + 16 * i].rstrip(b'\0').decode() for i in range(cols)]
+//   data = np.frombuffer(raw, '<i4', rows * cols, 12 + 16 * cols).reshape(cols, rows)
+
+// 逐级创建目录 (mkdir -p), 已经存在的目录不算出错
+bool makeDirs(const string &path) {
+	for (size_t end = 0; end != string::npos;) {
+		end = path.find('/', end + 1);
+		string prefix = path.substr(0, end);
+		if (mkdir(prefix.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) != 0 && errno != EEXIST) {
+			return false;
+		}
+	}
+	struct stat info{};
+	return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+// 逐块读取文本文件中的整数, 每 fields 个交给 fn, skipHeader 时跳过第一行
+template<class F>
+bool readRecords(const string &path, int fields, bool skipHeader, F &&fn) {
+	FILE *in = fopen(path.c_str(), "r");
+	if (in == nullptr) {
+		return false;
+	}
+	static char buf[1 << 16];
+	int value[8];
+	int field = 0;
+	int sign = 1;
+	int number = 0;
+	bool indigit = false;
+	bool header = skipHeader;
+	size_t len;
+	while ((len = fread(buf, 1, sizeof(buf), in)) > 0) {
+		for (size_t i = 0; i < len; ++i) {
+			char c = buf[i];
+			if (header) {
+				header = c != '\n';
+				continue;
+			}
+			if (c >= '0' && c <= '9') {
+				number = number * 10 + (c - '0');
+				indigit = true;
+			} else if (c == '-' && !indigit) {
+				sign = -1;
+			} else if (indigit) {
+				value[field++] = sign * number;
+				number = 0;
+				sign = 1;
+				indigit = false;
+				if (field == fields) {
+					field = 0;
+					fn(value);
+				}
+			}
+		}
+	}
+	if (indigit) {
+		value[field++] = sign * number;
+		if (field == fields) {
+			fn(value);
+		}
+	}
+	fclose(in);
+	return true;
+}
+
+// 一组流的统计
+class Group {
+public:
+	long long flows = 0;
+	long long dropped = 0;
+	long long bandwidthSum = 0;
+	int bandwidthMax = 0;
+	long long sendTimeSum = 0;
+	int sendTimeMax = 0;
+	long long work = 0;
+	vector<int> waits;
+
+	void add(int bandwidth, int sendTime, int wait, bool drop);
+	void write(FILE *out);
+};
+
+void Group::add(int bandwidth, int sendTime, int wait, bool drop) {
+	++flows;
+	bandwidthSum += bandwidth;
+	bandwidthMax = max(bandwidthMax, bandwidth);
+	sendTimeSum += sendTime;
+	sendTimeMax = max(sendTimeMax, sendTime);
+	if (drop) {
+		++dropped;
+	} else if (wait >= 0) {
+		waits.push_back(wait);
+		work += (long long) bandwidth * sendTime;
+	}
+}
+
+void Group::write(FILE *out) {
+	double waitMean = 0;
+	int p50 = 0;
+	int p90 = 0;
+	int waitMax = 0;
+	if (!waits.empty()) {
+		long long sum = 0;
+		for (int w: waits) {
+			sum += w;
+			waitMax = max(waitMax, w);
+		}
+		waitMean = (double) sum / waits.size();
+		nth_element(waits.begin(), waits.begin() + waits.size() / 2, waits.end());
+		p50 = waits[waits.size() / 2];
+		nth_element(waits.begin(), waits.begin() + waits.size() * 9 / 10, waits.end());
+		p90 = waits[waits.size() * 9 / 10];
+	}
+	fprintf(out, "%lld,%lld,%.4f,%d,%.4f,%d,%.4f,%d,%d,%d", flows, dropped,
+	        flows > 0 ? (double) bandwidthSum / flows : 0.0, bandwidthMax,
+	        flows > 0 ? (double) sendTimeSum / flows : 0.0, sendTimeMax, waitMean, p50, p90, waitMax);
+}
+
+// 分析一个数据集, 成功返回 true
+bool analyze(const string &path, const string &outPath, const RuleSet &rules) {
+	auto begin = chrono::steady_clock::now();
+	// 流按文件中的顺序编号 (行号), 流 id -> 行号 的稠密下标
+	vector<int> ids, bandwidths, starts, needs;
+	vector<int> rowOf;
+	bool ok = readRecords(path + "/flow.txt", 4, true, [&](const int *v) {
+		if (v[0] < 0) {
+			return;
+		}
+		if (v[0] >= (int) rowOf.size()) {
+			rowOf.resize(max((size_t) v[0] + 1, rowOf.size() * 2), -1);
+		}
+		rowOf[v[0]] = (int) ids.size();
+		ids.push_back(v[0]);
+		bandwidths.push_back(v[1]);
+		starts.push_back(v[2]);
+		needs.push_back(v[3]);
+	});
+	if (!ok) {
+		return false;
+	}
+	vector<int> capacities;
+	if (!readRecords(path + "/port.txt", 2, true, [&](const int *v) {
+		if (v[0] >= (int) capacities.size()) {
+			capacities.resize(v[0] + 1, 0);
+		}
+		capacities[v[0]] = v[1];
+	})) {
+		return false;
+	}
+	int n = (int) ids.size();
+	vector<int> port(n, -1), time(n, -1), dropped(n, 0);
+	// 结果: 流 id, 端口, 发送时间; solve1 / solve2 写出的结果本来就按发送时间排列, 不是时才排序
+	vector<int> resFlow, resPort, resTime;
+	bool sorted = true;
+	if (!readRecords(path + "/result.txt", 3, false, [&](const int *v) {
+		if (!resTime.empty() && v[2] < resTime.back()) {
+			sorted = false;
+		}
+		resFlow.push_back(v[0]);
+		resPort.push_back(v[1]);
+		resTime.push_back(v[2]);
+	})) {
+		cout << path << "：找不到结果文件" << endl;
+		return false;
+	}
+	vector<int> order(resTime.size());
+	for (int i = 0; i < (int) order.size(); ++i) {
+		order[i] = i;
+	}
+	if (!sorted) {
+		stable_sort(order.begin(), order.end(), [&](int x, int y) { return resTime[x] < resTime[y]; });
+	}
+
+	// 检查核心要求流 id 为 0..n-1、流按进入时间排列
+	vector<checker::Flow> checkFlows;
+	for (int i = 0; i < n; ++i) {
+		checkFlows.emplace_back(ids[i], bandwidths[i], starts[i], needs[i]);
+	}
+	stable_sort(checkFlows.begin(), checkFlows.end(),
+	            [](const checker::Flow &x, const checker::Flow &y) { return x.begintime < y.begintime; });
+	vector<checker::Port> checkPorts;
+	for (int i = 0; i < (int) capacities.size(); ++i) {
+		checkPorts.emplace_back(i, capacities[i]);
+	}
+	// 检查器拒绝时仍然把全部结果接到流上并写出分析文件, 方便查看是哪里出的问题;
+	// 拒绝之后的结果不再检查, dropped 只统计到被拒绝的那一条之前, 结论和出错信息写到标准错误
+	ostringstream verdict;
+	checker::errorstream() = &verdict;
+	size_t rejected = order.size();
+	int score = withRules(rules, [&](const auto &r) {
+		checker::BasicChecker<decay_t<decltype(r)>> check(checkFlows, checkPorts, r);
+		for (size_t i = 0; i < order.size(); ++i) {
+			int k = order[i];
+			if (rejected == order.size() && !check.push(checker::Result(resFlow[k], resPort[k], resTime[k]))) {
+				rejected = i;
+			}
+			if (resFlow[k] < 0 || resFlow[k] >= (int) rowOf.size() || rowOf[resFlow[k]] < 0) {
+				continue;
+			}
+			int row = rowOf[resFlow[k]];
+			port[row] = resPort[k];
+			time[row] = resTime[k];
+			dropped[row] = rejected == order.size() && check.dropped();
+		}
+		return rejected == order.size() ? check.finish() : 0;
+	});
+	checker::errorstream() = &cout;
+
+	// 按进入时间和端口分组
+	int lastStart = 0;
+	int longest = 0;
+	for (int i = 0; i < n; ++i) {
+		lastStart = max(lastStart, starts[i]);
+		longest = max(longest, needs[i]);
+	}
+	vector<Group> byStart(lastStart + 1);
+	vector<Group> byPort(capacities.size());
+	vector<vector<int>> hist(lastStart + 1);
+	vector<int> wait(n, -1);
+	for (int i = 0; i < n; ++i) {
+		if (time[i] >= 0) {
+			wait[i] = time[i] - starts[i];
+		}
+		byStart[starts[i]].add(bandwidths[i], needs[i], wait[i], dropped[i]);
+		if (port[i] >= 0) {
+			byPort[port[i]].add(bandwidths[i], needs[i], wait[i], dropped[i]);
+		}
+		if (hist[starts[i]].empty()) {
+			hist[starts[i]].assign(longest + 1, 0);
+		}
+		++hist[starts[i]][needs[i]];
+	}
+
+	// 四个输出文件先全部打开, 有一个打不开时都不写入
+	const char *files[] = {"/flows.zan", "/by_start.csv", "/by_port.csv", "/send_hist.csv"};
+	FILE *outs[4] = {};
+	for (int k = 0; k < 4; ++k) {
+		outs[k] = fopen((outPath + files[k]).c_str(), k == 0 ? "wb" : "w");
+		if (outs[k] == nullptr) {
+			cout << outPath << files[k] << "：无法写入分析结果" << endl;
+			for (int j = 0; j < k; ++j) {
+				fclose(outs[j]);
+			}
+			return false;
+		}
+	}
+	FILE *out = outs[0];
+	const char *names[] = {"id", "bandwidth", "startTime", "sendTime", "port", "time", "wait", "dropped"};
+	const vector<int> *columns[] = {&ids, &bandwidths, &starts, &needs, &port, &time, &wait, &dropped};
+	uint32_t rows = n;
+	uint32_t cols = 8;
+	fwrite("ZAN1", 1, 4, out);
+	fwrite(&rows, sizeof(rows), 1, out);
+	fwrite(&cols, sizeof(cols), 1, out);
+	for (const char *name: names) {
+		char padded[16] = {};
+		strncpy(padded, name, sizeof(padded) - 1);
+		fwrite(padded, 1, sizeof(padded), out);
+	}
+	for (const vector<int> *column: columns) {
+		fwrite(column->data(), sizeof(int), column->size(), out);
+	}
+	fclose(out);
+
+	const char *columnsHeader = "flows,dropped,bandwidth_mean,bandwidth_max,sendTime_mean,sendTime_max,"
+	                            "wait_mean,wait_p50,wait_p90,wait_max";
+	out = outs[1];
+	fprintf(out, "startTime,%s\n", columnsHeader);
+	for (int t = 0; t <= lastStart; ++t) {
+		if (byStart[t].flows == 0) {
+			continue;
+		}
+		fprintf(out, "%d,", t);
+		byStart[t].write(out);
+		fprintf(out, "\n");
+	}
+	fclose(out);
+	out = outs[2];
+	fprintf(out, "port,capacity,%s,work\n", columnsHeader);
+	for (int p = 0; p < (int) byPort.size(); ++p) {
+		fprintf(out, "%d,%d,", p, capacities[p]);
+		byPort[p].write(out);
+		fprintf(out, ",%lld\n", byPort[p].work);
+	}
+	fclose(out);
+	out = outs[3];
+	fprintf(out, "startTime,sendTime,count\n");
+	for (int t = 0; t <= lastStart; ++t) {
+		for (int s = 0; s < (int) hist[t].size(); ++s) {
+			if (hist[t][s] > 0) {
+				fprintf(out, "%d,%d,%d\n", t, s, hist[t][s]);
+			}
+		}
+	}
+	fclose(out);
+
+	long long drops = 0;
+	for (int d: dropped) {
+		drops += d;
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	string message = verdict.str();
+	while (!message.empty() && message.back() == '\n') {
+		message.pop_back();
+	}
+	if (score == 0 && rejected < order.size()) {
+		fprintf(stderr, "%s：结果不合法，第 %zu 条结果（按发送时间）被检查器拒绝：%s，丢弃只统计到此之前\n", path.c_str(),
+		        rejected + 1, message.c_str());
+	} else if (score == 0) {
+		fprintf(stderr, "%s：结果不合法：%s\n", path.c_str(), message.c_str());
+	}
+	fprintf(stderr, "%s：%d 个流，%zu 条结果，丢弃 %lld，检查器得分 %d，%.2f 秒\n", path.c_str(), n, resTime.size(), drops,
+	        score, seconds);
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	//--root 数据根目录 ：默认 ../data
+	//--out 输出目录 ：默认写在每个数据集自己的目录里，给出时写到 输出目录/N
+	//--rules 1|2 ：按 determine_1（没有排队区上限，不丢弃）或 determine_2（默认）的规则判断丢弃
+	//其余参数为数据集编号，不给时分析根目录下所有的数据集
+	string root = "../data";
+	string outRoot;
+	RuleSet rules;
+	vector<int> selected;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
+			root = argv[++i];
+		} else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+			outRoot = argv[++i];
+		} else if (strcmp(argv[i], "--rules") == 0 && i + 1 < argc) {
+			rules.queueing = atoi(argv[++i]) != 1;
+		} else {
+			selected.push_back(atoi(argv[i]));
+		}
+	}
+	if (selected.empty()) {
+		for (int No = 0;; ++No) {
+			ifstream f(root + "/" + to_string(No) + "/flow.txt");
+			if (!f.is_open()) {
+				break;
+			}
+			selected.push_back(No);
+		}
+	}
+	int failed = 0;
+	for (int No: selected) {
+		string path = root + "/" + to_string(No);
+		string outPath = outRoot.empty() ? path : outRoot + "/" + to_string(No);
+		if (!outRoot.empty()) {
+			if (!makeDirs(outPath)) {
+				cout << outPath << "：无法创建输出目录" << endl;
+				++failed;
+				continue;
+			}
+		}
+		if (!analyze(path, outPath, rules)) {
+			++failed;
+		}
+	}
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+#ifndef ZET_2023_BATCH_PACK_H
+#define ZET_2023_BATCH_PACK_H
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ZET_BATCH_PACK_AVX2 1
+#endif
+
+// 同一时刻缓存区里的流一起装箱, 代替 "按优先级逐个取出、放不下就停" 的发送方式
+//   箱子为各端口当前的剩余带宽, 物品为缓存区中每个流的带宽
+//   流按带宽从大到小 (相同时保持原来的优先级顺序) 逐个放入:
+//     ffd : 编号最小的放得下的端口 (First Fit Decreasing)
+//     bfd : 剩余带宽最小的放得下的端口, 相同时编号小的 (Best Fit Decreasing)
+//   放不下的流留在缓存区, 不挡住后面的流; 带宽不超过最大剩余带宽的流一定放得下,
+//   所以缓存区本身按带宽从大到小排列时 (solve1), 每次从第一个不超过 largest() 的流开始 place 即可, 不用每个时刻重新排序
+// 端口不超过 64 个时剩余带宽放在对齐数组里, 每个流用一次 AVX2 比较选出端口 (CPU 不支持时退回标量循环)
+enum class Packing {
+	none,
+	ffd,
+	bfd
+};
+
+// 命令行参数 "ffd" / "bfd" / "none", 不认识时返回 false
+inline bool parsePacking(const char *name, Packing &packing) {
+	if (strcmp(name, "ffd") == 0) {
+		packing = Packing::ffd;
+	} else if (strcmp(name, "bfd") == 0) {
+		packing = Packing::bfd;
+	} else if (strcmp(name, "none") == 0) {
+		packing = Packing::none;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+class BatchPacker {
+public:
+	static constexpr int MAX_BINS = 64;
+
+	// bins : 每个端口的剩余带宽 (按端口 id)
+	void reset(const std::vector<int> &bins);
+	// 最大的剩余带宽
+	int largest() const;
+	// 按 packing 的规则把带宽为 bw 的流放入一个端口, 返回端口, 放不下为 -1
+	int place(int bw, Packing packing);
+	// items : 按优先级排列的流带宽, 排序后逐个 place
+	// assigned[i] 为第 i 个流放入的端口, 放不下为 -1; 返回放入的流数量
+	int pack(const std::vector<int> &bins, const std::vector<int> &items, std::vector<int> &assigned, Packing packing);
+
+private:
+	alignas(32) int32_t remains[MAX_BINS];
+	// 端口多于 64 个时使用
+	std::vector<int> wide;
+	std::vector<int> order;
+	int binNum = 0;
+	int blocks = 0;
+	int maximum = 0;
+
+	int choose(int bw, Packing packing) const;
+	int chooseScalar(const int *values, int n, int bw, Packing packing) const;
+	static bool hasAvx2();
+#ifdef ZET_BATCH_PACK_AVX2
+	__attribute__((target("avx2"))) int chooseAvx2(int bw, Packing packing) const;
+#endif
+};
+
+inline bool BatchPacker::hasAvx2() {
+#ifdef ZET_BATCH_PACK_AVX2
+	static const bool supported = __builtin_cpu_supports("avx2");
+	return supported;
+#else
+	return false;
+#endif
+}
+
+inline int BatchPacker::chooseScalar(const int *values, int n, int bw, Packing packing) const {
+	int found = -1;
+	for (int i = 0; i < n; ++i) {
+		if (values[i] >= bw) {
+			if (packing == Packing::ffd) {
+				return i;
+			}
+			if (found < 0 || values[i] < values[found]) {
+				found = i;
+			}
+		}
+	}
+	return found;
+}
+
+#ifdef ZET_BATCH_PACK_AVX2
+__attribute__((target("avx2"))) inline int BatchPacker::chooseAvx2(int bw, Packing packing) const {
+	const __m256i limit = _mm256_set1_epi32(bw - 1);
+	if (packing == Packing::ffd) {
+		for (int b = 0; b < blocks; ++b) {
+			__m256i value = _mm256_load_si256((const __m256i *) (remains + 8 * b));
+			int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(value, limit)));
+			if (mask != 0) {
+				return 8 * b + __builtin_ctz(mask);
+			}
+		}
+		return -1;
+	}
+	// 最小的放得下的剩余带宽, 再找第一个等于它的端口
+	const __m256i none = _mm256_set1_epi32(INT_MAX);
+	__m256i best = none;
+	for (int b = 0; b < blocks; ++b) {
+		__m256i value = _mm256_load_si256((const __m256i *) (remains + 8 * b));
+		__m256i ok = _mm256_cmpgt_epi32(value, limit);
+		best = _mm256_min_epi32(best, _mm256_blendv_epi8(none, value, ok));
+	}
+	__m128i m = _mm_min_epi32(_mm256_castsi256_si128(best), _mm256_extracti128_si256(best, 1));
+	m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+	m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+	int32_t target = _mm_cvtsi128_si32(m);
+	if (target == INT_MAX) {
+		return -1;
+	}
+	const __m256i wanted = _mm256_set1_epi32(target);
+	for (int b = 0; b < blocks; ++b) {
+		__m256i value = _mm256_load_si256((const __m256i *) (remains + 8 * b));
+		int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(value, wanted)));
+		if (mask != 0) {
+			return 8 * b + __builtin_ctz(mask);
+		}
+	}
+	return -1;
+}
+#endif
+
+inline int BatchPacker::choose(int bw, Packing packing) const {
+	if (binNum > MAX_BINS) {
+		return chooseScalar(wide.data(), binNum, bw, packing);
+	}
+#ifdef ZET_BATCH_PACK_AVX2
+	if (hasAvx2()) {
+		return chooseAvx2(bw, packing);
+	}
+#endif
+	return chooseScalar(remains, binNum, bw, packing);
+}
+
+inline void BatchPacker::reset(const std::vector<int> &bins) {
+	binNum = (int) bins.size();
+	blocks = (binNum + 7) / 8;
+	if (binNum > MAX_BINS) {
+		wide = bins;
+	} else {
+		// 空位为 -1, 永远放不下
+		for (int i = 0; i < 8 * blocks; ++i) {
+			remains[i] = i < binNum ? bins[i] : -1;
+		}
+	}
+	maximum = bins.empty() ? -1 : *std::max_element(bins.begin(), bins.end());
+}
+
+inline int BatchPacker::largest() const {
+	return maximum;
+}
+
+inline int BatchPacker::place(int bw, Packing packing) {
+	if (bw > maximum) {
+		return -1;
+	}
+	int bin = choose(bw, packing);
+	if (bin < 0) {
+		return -1;
+	}
+	int *values = binNum > MAX_BINS ? wide.data() : remains;
+	// 放入的是最大的端口时重新求最大值
+	bool top = values[bin] == maximum;
+	values[bin] -= bw;
+	if (top) {
+		maximum = *std::max_element(values, values + binNum);
+	}
+	return bin;
+}
+
+inline int BatchPacker::pack(const std::vector<int> &bins, const std::vector<int> &items, std::vector<int> &assigned,
+                             Packing packing) {
+	reset(bins);
+	assigned.assign(items.size(), -1);
+	order.clear();
+	for (int i = 0; i < (int) items.size(); ++i) {
+		if (items[i] <= maximum) {
+			order.push_back(i);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int x, int y) { return items[x] > items[y]; });
+	int placed = 0;
+	for (int i: order) {
+		assigned[i] = place(items[i], packing);
+		if (assigned[i] >= 0) {
+			++placed;
+		}
+	}
+	return placed;
+}
+
+#endif //ZET_2023_BATCH_PACK_H
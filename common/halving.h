@@ -0,0 +1,80 @@
+#ifndef ZET_2023_HALVING_H
+#define ZET_2023_HALVING_H
+
+#include <algorithm>
+#include <list>
+#include <vector>
+
+// 多保真度候选剪枝 (successive halving), 用于权重扫描
+// 第 0 级用数据集的一小段前缀 (按进入设备时间) 给所有候选打分, 只保留得分最好的 keep 比例,
+// 下一级前缀长度翻倍, 直到最后一级用完整数据集给剩下的候选打分
+// 得分越小越好, 得分相同时候选编号小的优先, 与穷举时 "遇到更小的才替换" 选出的候选一致
+struct HalvingResult {
+	int best = -1;
+	long long score = 0;
+	// 每一级的前缀比例和参与打分的候选数量
+	std::vector<double> rungs;
+	std::vector<int> evaluated;
+};
+
+// 从 start 开始每级翻倍的前缀比例, 最后一级为 1
+inline std::vector<double> halvingRungs(double start) {
+	std::vector<double> rungs;
+	for (double f = start; f < 1 && f > 0; f *= 2) {
+		rungs.push_back(f);
+	}
+	rungs.push_back(1);
+	return rungs;
+}
+
+// 每一级使用的流: 进入设备时间不超过 "最后一个流的进入时间 * 前缀比例" 的流, flows 须按进入时间升序
+template<class Flow>
+std::vector<std::list<Flow>> prefixFlows(const std::list<Flow> &flows, const std::vector<double> &rungs) {
+	std::vector<std::list<Flow>> prefixes;
+	int last = flows.empty() ? 0 : flows.back().startTime;
+	for (double f: rungs) {
+		double horizon = f * last;
+		std::list<Flow> prefix;
+		for (const Flow &flow: flows) {
+			if (f < 1 && flow.startTime > horizon) {
+				break;
+			}
+			prefix.push_back(flow);
+		}
+		prefixes.push_back(prefix);
+	}
+	return prefixes;
+}
+
+// eval(candidate, rung) 返回候选在第 rung 级前缀上的得分
+template<class Eval>
+HalvingResult successiveHalving(int candidates, double start, double keep, Eval eval) {
+	HalvingResult result;
+	result.rungs = halvingRungs(start);
+	std::vector<int> alive(candidates);
+	for (int i = 0; i < candidates; ++i) {
+		alive[i] = i;
+	}
+	std::vector<std::pair<long long, int>> scored;
+	for (int rung = 0; rung < (int) result.rungs.size() && !alive.empty(); ++rung) {
+		scored.clear();
+		for (int candidate: alive) {
+			scored.emplace_back(eval(candidate, rung), candidate);
+		}
+		result.evaluated.push_back((int) alive.size());
+		std::sort(scored.begin(), scored.end());
+		size_t survivors = scored.size();
+		if (rung + 1 < (int) result.rungs.size()) {
+			survivors = std::max<size_t>(1, (size_t) ((double) scored.size() * keep + 0.5));
+		}
+		alive.clear();
+		for (size_t i = 0; i < survivors; ++i) {
+			alive.push_back(scored[i].second);
+		}
+	}
+	result.best = scored.front().second;
+	result.score = scored.front().first;
+	return result;
+}
+
+#endif //ZET_2023_HALVING_H
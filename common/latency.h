@@ -0,0 +1,254 @@
+#ifndef ZET_2023_LATENCY_H
+#define ZET_2023_LATENCY_H
+
+#include <cstdio>
+#include <vector>
+
+// 每个流的延迟 (单位为时刻), 调度器和检查器在流离开缓存区、开始发送、被丢弃时记录:
+//   buffer     : 缓存区等待, 离开缓存区 (进入排队区、直接发送或被丢弃) 的时刻 - 进入设备的时刻
+//   queue      : 排队区等待, 开始发送的时刻 - 离开缓存区的时刻, 直接发送时为 0
+//   completion : 完成时间, 发送完毕的时刻 - 进入设备的时刻
+//   wait       : 等待时间, buffer + queue, 即开始发送的时刻 - 进入设备的时刻
+// 被丢弃的流只有 buffer, 不计入 queue、completion 和 wait 的分布, 单独计数
+// 分布用 HDR 式的对数线性直方图: 小于 256 的值精确记录, 更大的值每个 2 的幂区间分成 128 格, 相对误差不超过 1/128,
+// 记录一个值只是一次计数, 各分组的直方图只增长到实际出现过的最大格, 端口多时也不占多少内存
+
+class LatencyHistogram {
+public:
+	static constexpr int subBits = 7;
+
+	void record(int value);
+	void merge(const LatencyHistogram &other);
+	long long count() const;
+	double mean() const;
+	int max() const;
+	// 第 q (0 < q <= 1) 分位数: 排在第 ceil(q * count) 位的值所在格的上界, 没有记录时为 -1
+	int percentile(double q) const;
+
+private:
+	std::vector<long long> counts;
+	long long total = 0;
+	long long sum = 0;
+	int maximum = -1;
+
+	static int bucket(int value);
+	static int highest(int index);
+};
+
+inline int LatencyHistogram::bucket(int value) {
+	if (value < (2 << subBits)) {
+		return value;
+	}
+	int shift = 31 - __builtin_clz((unsigned) value) - subBits;
+	return (shift << subBits) + (value >> shift);
+}
+
+inline int LatencyHistogram::highest(int index) {
+	if (index < (2 << subBits)) {
+		return index;
+	}
+	int shift = (index >> subBits) - 1;
+	long long mantissa = index - (shift << subBits);
+	return (int) (((mantissa + 1) << shift) - 1);
+}
+
+inline void LatencyHistogram::record(int value) {
+	if (value < 0) {
+		value = 0;
+	}
+	int index = bucket(value);
+	if (index >= (int) counts.size()) {
+		counts.resize(index + 1, 0);
+	}
+	++counts[index];
+	++total;
+	sum += value;
+	if (value > maximum) {
+		maximum = value;
+	}
+}
+
+inline void LatencyHistogram::merge(const LatencyHistogram &other) {
+	if (other.counts.size() > counts.size()) {
+		counts.resize(other.counts.size(), 0);
+	}
+	for (size_t i = 0; i < other.counts.size(); ++i) {
+		counts[i] += other.counts[i];
+	}
+	total += other.total;
+	sum += other.sum;
+	if (other.maximum > maximum) {
+		maximum = other.maximum;
+	}
+}
+
+inline long long LatencyHistogram::count() const {
+	return total;
+}
+
+inline double LatencyHistogram::mean() const {
+	return total > 0 ? (double) sum / (double) total : 0.0;
+}
+
+inline int LatencyHistogram::max() const {
+	return maximum;
+}
+
+inline int LatencyHistogram::percentile(double q) const {
+	if (total == 0) {
+		return -1;
+	}
+	long long rank = (long long) (q * (double) total);
+	if ((double) rank < q * (double) total) {
+		++rank;
+	}
+	if (rank < 1) {
+		rank = 1;
+	}
+	long long seen = 0;
+	for (size_t i = 0; i < counts.size(); ++i) {
+		seen += counts[i];
+		if (seen >= rank) {
+			int value = highest((int) i);
+			return value < maximum ? value : maximum;
+		}
+	}
+	return maximum;
+}
+
+struct FlowLatency {
+	int port = -1;
+	int buffer = -1;
+	int queue = -1;
+	int completion = -1;
+};
+
+// 按全部、端口、带宽等级 ([2^k, 2^(k+1))) 分组的延迟分布, 以及每个流的延迟
+// 流的下标由调用方决定 (solve2 为按进入设备排序后的下标, 检查器为 flows 中的下标, solve1 为结果的顺序)
+class LatencyTracker {
+public:
+	enum Metric {
+		buffer, queue, completion, wait, metrics
+	};
+
+	LatencyTracker(int portNum, size_t flowNum);
+	// 进入设备的时刻为 arrival 的流在 time 离开缓存区, 进入端口 port 的排队区或直接发送
+	void leave(int index, int port, int arrival, int time);
+	// 流在 time 开始发送
+	void start(int index, int bandwidth, int arrival, int time, int sendTime);
+	// 流被丢弃, 端口为 leave 时给出的端口
+	void drop(int index, int bandwidth);
+	const FlowLatency &flow(int index) const;
+	const LatencyHistogram &overall(Metric metric) const;
+	long long dropped() const;
+	// 开始发送的流按带宽加权的平均完成时间
+	double weightedCompletion() const;
+	// csv: scope,key,metric,count,dropped,mean,p50,p90,p99,p999,max, scope 为 all、port 或 class
+	void write(FILE *out) const;
+	// 一行的摘要: 各种延迟全部流的 p50/p90/p99/p999、加权平均完成时间和丢弃数量
+	void summary(FILE *out) const;
+
+private:
+	struct Group {
+		LatencyHistogram histograms[metrics];
+		long long dropped = 0;
+	};
+
+	std::vector<FlowLatency> flows;
+	Group all;
+	std::vector<Group> ports;
+	std::vector<Group> classes;
+	long long weights = 0;
+	long long weightedSum = 0;
+
+	Group &classOf(int bandwidth);
+	static void writeGroup(FILE *out, const char *scope, const char *key, const Group &group);
+};
+
+inline LatencyTracker::LatencyTracker(int portNum, size_t flowNum) : flows(flowNum), ports(portNum), classes(32) {}
+
+inline LatencyTracker::Group &LatencyTracker::classOf(int bandwidth) {
+	return classes[bandwidth > 0 ? 31 - __builtin_clz((unsigned) bandwidth) : 0];
+}
+
+inline void LatencyTracker::leave(int index, int port, int arrival, int time) {
+	FlowLatency &f = flows[index];
+	f.port = port;
+	f.buffer = time - arrival;
+}
+
+inline void LatencyTracker::start(int index, int bandwidth, int arrival, int time, int sendTime) {
+	FlowLatency &f = flows[index];
+	f.queue = time - arrival - f.buffer;
+	f.completion = time + sendTime - arrival;
+	for (Group *group: {&all, &ports[f.port], &classOf(bandwidth)}) {
+		group->histograms[buffer].record(f.buffer);
+		group->histograms[queue].record(f.queue);
+		group->histograms[completion].record(f.completion);
+		group->histograms[wait].record(f.buffer + f.queue);
+	}
+	weights += bandwidth;
+	weightedSum += (long long) bandwidth * f.completion;
+}
+
+inline void LatencyTracker::drop(int index, int bandwidth) {
+	const FlowLatency &f = flows[index];
+	for (Group *group: {&all, &ports[f.port], &classOf(bandwidth)}) {
+		group->histograms[buffer].record(f.buffer);
+		++group->dropped;
+	}
+}
+
+inline const FlowLatency &LatencyTracker::flow(int index) const {
+	return flows[index];
+}
+
+inline const LatencyHistogram &LatencyTracker::overall(Metric metric) const {
+	return all.histograms[metric];
+}
+
+inline long long LatencyTracker::dropped() const {
+	return all.dropped;
+}
+
+inline double LatencyTracker::weightedCompletion() const {
+	return weights > 0 ? (double) weightedSum / (double) weights : 0.0;
+}
+
+inline void LatencyTracker::writeGroup(FILE *out, const char *scope, const char *key, const Group &group) {
+	static const char *names[metrics] = {"buffer", "queue", "completion", "wait"};
+	for (int m = 0; m < metrics; ++m) {
+		const LatencyHistogram &h = group.histograms[m];
+		fprintf(out, "%s,%s,%s,%lld,%lld,%.3f,%d,%d,%d,%d,%d\n", scope, key, names[m], h.count(), group.dropped,
+		        h.mean(), h.percentile(0.5), h.percentile(0.9), h.percentile(0.99), h.percentile(0.999), h.max());
+	}
+}
+
+inline void LatencyTracker::write(FILE *out) const {
+	fprintf(out, "scope,key,metric,count,dropped,mean,p50,p90,p99,p999,max\n");
+	writeGroup(out, "all", "", all);
+	char key[32];
+	for (size_t id = 0; id < ports.size(); ++id) {
+		snprintf(key, sizeof(key), "%zu", id);
+		writeGroup(out, "port", key, ports[id]);
+	}
+	for (int k = 0; k < (int) classes.size(); ++k) {
+		if (classes[k].histograms[buffer].count() == 0) {
+			continue;
+		}
+		snprintf(key, sizeof(key), "%lld-%lld", 1LL << k, (2LL << k) - 1);
+		writeGroup(out, "class", key, classes[k]);
+	}
+}
+
+inline void LatencyTracker::summary(FILE *out) const {
+	static const char *names[metrics] = {"缓存区等待", "排队区等待", "完成时间", "等待时间"};
+	for (int m = 0; m < metrics; ++m) {
+		const LatencyHistogram &h = all.histograms[m];
+		fprintf(out, "%s p50 %d p90 %d p99 %d p999 %d，", names[m], h.percentile(0.5), h.percentile(0.9),
+		        h.percentile(0.99), h.percentile(0.999));
+	}
+	fprintf(out, "加权完成时间 %.2f，丢弃 %lld\n", weightedCompletion(), all.dropped);
+}
+
+#endif //ZET_2023_LATENCY_H
@@ -0,0 +1,309 @@
+#ifndef ZET_2023_LOWER_BOUND_H
+#define ZET_2023_LOWER_BOUND_H
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "rules.h"
+
+// 数据集总时间 (检查器给出的结果) 的下界, 取以下几种中最大的一个
+//   energy : 原来的 best(), 全部流的 带宽 * 发送所需时间 之和 / 全部端口带宽之和
+//   capacity : 带宽大于第 k+1 大端口带宽的流只能发到最大的 k 个端口, 并且不能早于进入设备时间开始发送,
+//              对每个 k 和时刻 τ: 总时间 >= τ + 进入时间不早于 τ 的这类流的 带宽 * 时间 之和 / 最大 k 个端口的带宽之和
+//   single : 总时间不小于最晚的进入时间, 也不小于每个流的 进入时间 + 发送所需时间
+//   drops : 缓存区和排队区上限逼出来的丢弃罚时, 见 dropBound
+// 有排队区时每个流都可以丢弃, 前三种下界中每个流的贡献取 "发送" 和 "丢弃罚时" 中较小的一个
+struct BoundFlow {
+	int bandwidth;
+	int start;
+	int need;
+};
+
+struct LowerBound {
+	double energy = 0;
+	double capacity = 0;
+	double single = 0;
+	double drops = 0;
+
+	double value() const {
+		return std::max(std::max(energy, capacity), std::max(single, drops));
+	}
+};
+
+// 得分与下界的相对差距, 0 为已经最优
+inline double boundGap(double score, double bound) {
+	return score > 0 ? std::max(0.0, (score - bound) / score) : 0;
+}
+
+// 一个流在总带宽为 capacity 的端口上至少要占用的总时间, 有排队区时不超过丢弃它的罚时
+template<class R>
+inline double flowCost(const BoundFlow &f, long long capacity, const R &rules) {
+	double send = (double) f.bandwidth * f.need / (double) capacity;
+	return R::queueing ? std::min(send, (double) rules.penalty * f.need) : send;
+}
+
+template<class R>
+inline double energyBound(const std::vector<BoundFlow> &flows, const std::vector<int> &portBandwidths,
+                          const R &rules) {
+	long long capacity = 0;
+	for (int bandwidth: portBandwidths) {
+		capacity += bandwidth;
+	}
+	double bound = 0;
+	for (const BoundFlow &f: flows) {
+		bound += flowCost(f, capacity, rules);
+	}
+	return bound;
+}
+
+template<class R>
+inline double capacityBound(const std::vector<BoundFlow> &flows, const std::vector<int> &portBandwidths,
+                            const R &rules) {
+	std::vector<int> caps(portBandwidths);
+	std::sort(caps.begin(), caps.end(), std::greater<>());
+	// 按进入时间从晚到早, 累加得到进入时间不早于 τ 的流
+	std::vector<const BoundFlow *> order;
+	for (const BoundFlow &f: flows) {
+		order.push_back(&f);
+	}
+	std::sort(order.begin(), order.end(), [](const BoundFlow *x, const BoundFlow *y) { return x->start > y->start; });
+	double bound = 0;
+	long long capacity = 0;
+	for (size_t k = 0; k < caps.size(); ++k) {
+		capacity += caps[k];
+		// 带宽相同的端口一起算
+		if (k + 1 < caps.size() && caps[k + 1] == caps[k]) {
+			continue;
+		}
+		int threshold = k + 1 < caps.size() ? caps[k + 1] : 0;
+		double energy = 0;
+		for (size_t i = 0; i < order.size(); ++i) {
+			if (order[i]->bandwidth > threshold) {
+				energy += flowCost(*order[i], capacity, rules);
+			}
+			if (i + 1 == order.size() || order[i + 1]->start != order[i]->start) {
+				bound = std::max(bound, order[i]->start + energy);
+			}
+		}
+	}
+	return bound;
+}
+
+template<class R>
+inline double singleBound(const std::vector<BoundFlow> &flows, const R &rules) {
+	int last = 0;
+	for (const BoundFlow &f: flows) {
+		last = std::max(last, f.start);
+	}
+	double bound = last;
+	for (const BoundFlow &f: flows) {
+		double send = (double) f.start + f.need;
+		bound = std::max(bound, R::queueing ? std::min(send, last + (double) rules.penalty * f.need) : send);
+	}
+	return bound;
+}
+
+// 丢弃罚时的下界 (线性规划松弛)
+// t 时刻结束时, 已进入设备且不会被丢弃的流要么已经开始发送, 要么在排队区里 (每个端口不超过 queueLimit),
+// 要么还在缓存区里 (不超过 bufferFactor * 端口数); 已经开始发送的流在 [0, t + h] 内至少占用
+// 带宽 * min(发送所需时间, h + 1) 的带宽时间, 总共不超过 全部端口带宽之和 * (t + h + 1)
+// 所以不被丢弃能省下的罚时不超过: 罚时最大的 (bufferFactor + queueLimit) * 端口数 个流,
+// 加上以 带宽 * min(时间, h + 1) 为重量、全部端口带宽之和 * (t + h + 1) 为容量的分数背包
+// 对若干 (t, h) 取 "这些流的全部罚时 - 能省下的罚时上界" 的最大值, 再加上总时间至少为最晚的进入时间
+template<class R>
+inline double dropBound(const std::vector<BoundFlow> &flows, const std::vector<int> &portBandwidths,
+                        const R &rules) {
+	if (!R::queueing || flows.empty()) {
+		return 0;
+	}
+	long long capacity = 0;
+	for (int bandwidth: portBandwidths) {
+		capacity += bandwidth;
+	}
+	size_t keep = (size_t) (rules.bufferFactor + rules.queueLimit) * portBandwidths.size();
+	int n = (int) flows.size();
+	int last = 0;
+	int longest = 1;
+	std::vector<int> starts;
+	for (const BoundFlow &f: flows) {
+		last = std::max(last, f.start);
+		longest = std::max(longest, f.need);
+		starts.push_back(f.start);
+	}
+	// 候选的 t: 不同的进入时间中从最晚的开始均匀取至多 16 个
+	std::sort(starts.begin(), starts.end());
+	starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+	std::vector<int> times;
+	int step = std::max(1, ((int) starts.size() + 15) / 16);
+	for (int i = (int) starts.size() - 1; i >= 0; i -= step) {
+		times.push_back(starts[i]);
+	}
+	// 与 h 无关的部分每个 t 只算一次: 已进入设备的流的全部罚时, 和罚时最大的 keep 个流的罚时 (按罚时计数)
+	std::vector<double> totals(times.size(), 0);
+	std::vector<double> kept(times.size(), 0);
+	std::vector<long long> counts(longest + 1);
+	for (size_t k = 0; k < times.size(); ++k) {
+		std::fill(counts.begin(), counts.end(), 0);
+		for (const BoundFlow &f: flows) {
+			if (f.start <= times[k]) {
+				totals[k] += f.need;
+				++counts[std::max(f.need, 0)];
+			}
+		}
+		long long left = (long long) keep;
+		for (int need = longest; need > 0 && left > 0; --need) {
+			long long taken = std::min(left, counts[need]);
+			kept[k] += (double) need * taken;
+			left -= taken;
+		}
+	}
+	// 分数背包按 罚时 / 重量 从大到小取, 这个顺序不需要每个 h 重新排序:
+	//   发送所需时间不超过 span 的流重量为 带宽 * 时间, 比值为 1 / 带宽, 按带宽从小到大
+	//   超过 span 的流重量为 带宽 * span, 比值为 时间 / (带宽 * span), 按 时间 / 带宽 从大到小
+	// 两种顺序各算一次 (相等时按下标), 每个 h 归并一遍; 罚时为 0 的流对背包没有贡献, 不参与
+	// 带宽和罚时都是不大的整数, 按带宽计数排序, 再按罚时分组 (组内仍按带宽从小到大), 用堆归并各组得到第二种顺序
+	struct Shape {
+		int start;
+		int need;
+		int bandwidth;
+		int index;
+	};
+	int widest = 0;
+	for (const BoundFlow &f: flows) {
+		widest = std::max(widest, f.bandwidth);
+	}
+	std::vector<int> slots(widest + 2, 0);
+	for (const BoundFlow &f: flows) {
+		if (f.need > 0) {
+			++slots[f.bandwidth + 1];
+		}
+	}
+	for (int bandwidth = 0; bandwidth <= widest; ++bandwidth) {
+		slots[bandwidth + 1] += slots[bandwidth];
+	}
+	std::vector<Shape> byBandwidth(slots[widest + 1]);
+	for (int i = 0; i < n; ++i) {
+		const BoundFlow &f = flows[i];
+		if (f.need > 0) {
+			byBandwidth[slots[f.bandwidth]++] = {f.start, f.need, f.bandwidth, i};
+		}
+	}
+	// 罚时为 v 的一组为 grouped[first[v], first[v + 1])
+	std::vector<int> first(longest + 2, 0);
+	for (const Shape &f: byBandwidth) {
+		++first[f.need + 1];
+	}
+	for (int need = 0; need <= longest; ++need) {
+		first[need + 1] += first[need];
+	}
+	std::vector<int> heads(first.begin(), first.end() - 1);
+	std::vector<Shape> grouped(byBandwidth.size());
+	for (const Shape &f: byBandwidth) {
+		grouped[heads[f.need]++] = f;
+	}
+	std::copy(first.begin(), first.end() - 1, heads.begin());
+	// 堆顶为第一个流 时间 / 带宽 最大的组
+	auto later = [&](int v, int w) {
+		const Shape &x = grouped[heads[v]];
+		const Shape &y = grouped[heads[w]];
+		long long left = (long long) v * y.bandwidth;
+		long long right = (long long) w * x.bandwidth;
+		return left != right ? left < right : x.index > y.index;
+	};
+	std::vector<int> heap;
+	for (int need = 1; need <= longest; ++need) {
+		if (first[need] < first[need + 1]) {
+			heap.push_back(need);
+		}
+	}
+	std::make_heap(heap.begin(), heap.end(), later);
+	std::vector<Shape> byDensity;
+	byDensity.reserve(grouped.size());
+	while (!heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end(), later);
+		int need = heap.back();
+		byDensity.push_back(grouped[heads[need]++]);
+		if (heads[need] < first[need + 1]) {
+			std::push_heap(heap.begin(), heap.end(), later);
+		} else {
+			heap.pop_back();
+		}
+	}
+	// 每个 h 按背包顺序把流依次放进一个连续的数组, 每个 t 从头扫到背包装满
+	struct Item {
+		int start;
+		int need;
+		long long weight;
+	};
+	std::vector<Item> order;
+	order.reserve(byBandwidth.size());
+	double bound = 0;
+	for (int h = 0;; h = std::max(h + 1, h * 3 / 2)) {
+		int span = h + 1;
+		order.clear();
+		auto x = byBandwidth.begin();
+		auto y = byDensity.begin();
+		while (true) {
+			while (x != byBandwidth.end() && x->need > span) {
+				++x;
+			}
+			while (y != byDensity.end() && y->need <= span) {
+				++y;
+			}
+			if (x == byBandwidth.end() && y == byDensity.end()) {
+				break;
+			}
+			// 1 / 带宽x >= 时间y / (带宽y * span) 时先取 x
+			const Shape &f = y == byDensity.end() || (x != byBandwidth.end() && (long long) y->bandwidth * span >=
+			                                                                    (long long) y->need * x->bandwidth)
+			                 ? *x++ : *y++;
+			order.push_back({f.start, f.need, (long long) f.bandwidth * std::min(f.need, span)});
+		}
+		for (size_t k = 0; k < times.size(); ++k) {
+			int t = times[k];
+			double saved = kept[k];
+			double room = (double) capacity * (t + span);
+			// 背包装满后后面的流不会再省下罚时
+			for (auto item = order.begin(); item != order.end() && room > 0; ++item) {
+				if (item->start > t) {
+					continue;
+				}
+				if (room >= item->weight) {
+					room -= item->weight;
+					saved += item->need;
+				} else {
+					saved += item->need * room / item->weight;
+					room = 0;
+				}
+			}
+			bound = std::max(bound, last + rules.penalty * std::max(0.0, totals[k] - saved));
+		}
+		if (span >= longest) {
+			break;
+		}
+	}
+	return bound;
+}
+
+template<class R>
+inline LowerBound lowerBoundWith(const std::vector<BoundFlow> &flows, const std::vector<int> &portBandwidths,
+                                 const R &rules) {
+	LowerBound bound;
+	if (flows.empty() || portBandwidths.empty()) {
+		return bound;
+	}
+	bound.energy = energyBound(flows, portBandwidths, rules);
+	bound.capacity = capacityBound(flows, portBandwidths, rules);
+	bound.single = singleBound(flows, rules);
+	bound.drops = dropBound(flows, portBandwidths, rules);
+	return bound;
+}
+
+inline LowerBound lowerBound(const std::vector<BoundFlow> &flows, const std::vector<int> &portBandwidths,
+                             const RuleSet &rules = RuleSet()) {
+	return withRules(rules, [&](const auto &r) {
+		return lowerBoundWith(flows, portBandwidths, r);
+	});
+}
+
+#endif //ZET_2023_LOWER_BOUND_H
@@ -0,0 +1,146 @@
+#ifndef ZET_2023_PORT_INDEX_H
+#define ZET_2023_PORT_INDEX_H
+
+#include <algorithm>
+#include <climits>
+#include <set>
+#include <vector>
+
+// 端口很多 (P > 64, 几千到几万个) 时的端口选择引擎, 接口和选出的端口与 port_search.h 的 PortSearch 相同
+// 两级索引: 端口按带宽分成若干容量等级 (带宽 / classWidth, 数据中带宽都是 1000 的倍数, 每个带宽一个等级),
+// 每个等级一棵按 (剩余带宽, 先后) 排列的平衡树, 另外记录每个等级中最大的剩余带宽
+//   bestFit : 顺序扫描各等级的最大剩余带宽, 只在放得下的等级里 lower_bound, 取其中最小的, O(等级数 + log P)
+//   commit  : 在端口所在等级的树里删除旧键、插入新键, 更新这个等级的最大值, O(log P)
+// 剩余带宽相同的端口之间的先后与 PortSearch (稳定插入排序) 相同:
+//   剩余带宽变小的端口排到相同端口的最后, 变大的排到最前, 没变的不动
+//   所以用一个全局计数器: 变小时先后键为 +计数, 变大时为 -计数, 初始为端口在初始顺序中的位置
+// 原来的 "每次修改后 sort + 二分" 在端口多于 16 个时 std::sort 不是稳定排序, 相同剩余带宽的先后没有规律,
+// 这里统一为和端口少时相同的稳定顺序
+class PortIndex {
+public:
+	static constexpr int classWidth = 1000;
+
+	// descending 的含义与 PortSearch 相同: 初始时带宽相同的端口按 id 倒序 (solve1) 或顺序 (solve2)
+	PortIndex(const std::vector<int> &bandwidths, bool descending);
+	int remain(int id) const;
+	// 剩余带宽减少 bw (bw 为负数时为释放), 修改后需要调用 commit 更新索引
+	void modify(int id, int bw);
+	void commit(int id);
+	int maxRemain() const;
+	// 剩余带宽 >= bw 的端口中剩余带宽最小的一个, 相同时取排在前面的, 没有返回 -1
+	int bestFit(int bw) const;
+
+private:
+	struct Key {
+		int remain;
+		long long order;
+		int id;
+
+		bool operator<(const Key &other) const {
+			return remain != other.remain ? remain < other.remain : order < other.order;
+		}
+	};
+
+	// 按容量从小到大排列的等级, 各等级的最大剩余带宽放在连续数组里, 扫描时不碰树
+	std::vector<int> capacities;
+	std::vector<int> tops;
+	std::vector<std::set<Key>> trees;
+	// 端口 id -> 等级, 当前剩余带宽, 在树中的键
+	std::vector<int> classOf;
+	std::vector<int> remains;
+	std::vector<Key> keys;
+	long long counter;
+	int maximum = -1;
+
+	void refresh(int c);
+};
+
+inline PortIndex::PortIndex(const std::vector<int> &bandwidths, bool descending) {
+	int portNum = (int) bandwidths.size();
+	for (int bw: bandwidths) {
+		capacities.push_back(bw / classWidth);
+	}
+	std::sort(capacities.begin(), capacities.end());
+	capacities.erase(std::unique(capacities.begin(), capacities.end()), capacities.end());
+	trees.resize(capacities.size());
+	tops.assign(capacities.size(), -1);
+	// 初始顺序: 按带宽稳定排序, 相同带宽按 id 顺序 (descending 时倒序)
+	std::vector<int> order(portNum);
+	for (int k = 0; k < portNum; ++k) {
+		order[k] = descending ? portNum - 1 - k : k;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int x, int y) { return bandwidths[x] < bandwidths[y]; });
+	remains = bandwidths;
+	keys.resize(portNum);
+	classOf.resize(portNum);
+	for (int pos = 0; pos < portNum; ++pos) {
+		int id = order[pos];
+		classOf[id] = (int) (std::lower_bound(capacities.begin(), capacities.end(), bandwidths[id] / classWidth) -
+		                     capacities.begin());
+		keys[id] = {bandwidths[id], pos, id};
+		trees[classOf[id]].insert(keys[id]);
+	}
+	counter = portNum;
+	for (int c = 0; c < (int) capacities.size(); ++c) {
+		refresh(c);
+	}
+}
+
+inline void PortIndex::refresh(int c) {
+	int old = tops[c];
+	tops[c] = trees[c].empty() ? -1 : trees[c].rbegin()->remain;
+	if (tops[c] >= maximum) {
+		maximum = tops[c];
+	} else if (old == maximum) {
+		maximum = *std::max_element(tops.begin(), tops.end());
+	}
+}
+
+inline int PortIndex::remain(int id) const {
+	return remains[id];
+}
+
+inline void PortIndex::modify(int id, int bw) {
+	remains[id] -= bw;
+}
+
+inline void PortIndex::commit(int id) {
+	Key &key = keys[id];
+	if (remains[id] == key.remain) {
+		return;
+	}
+	std::set<Key> &tree = trees[classOf[id]];
+	tree.erase(key);
+	key.order = remains[id] < key.remain ? counter : -counter;
+	key.remain = remains[id];
+	++counter;
+	tree.insert(key);
+	refresh(classOf[id]);
+}
+
+inline int PortIndex::maxRemain() const {
+	return maximum;
+}
+
+inline int PortIndex::bestFit(int bw) const {
+	if (bw > maximum) {
+		return -1;
+	}
+	// 容量等级低于 bw 的端口剩余带宽一定不够
+	int first = (int) (std::lower_bound(capacities.begin(), capacities.end(), std::max(bw, 0) / classWidth) -
+	                   capacities.begin());
+	const Key *best = nullptr;
+	Key probe{bw, LLONG_MIN, -1};
+	for (int c = first; c < (int) capacities.size(); ++c) {
+		if (tops[c] < bw) {
+			continue;
+		}
+		const Key &found = *trees[c].lower_bound(probe);
+		if (best == nullptr || found < *best) {
+			best = &found;
+		}
+	}
+	return best == nullptr ? -1 : best->id;
+}
+
+#endif //ZET_2023_PORT_INDEX_H
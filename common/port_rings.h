@@ -0,0 +1,103 @@
+#ifndef ZET_2023_PORT_RINGS_H
+#define ZET_2023_PORT_RINGS_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// 所有端口的排队区, 队列里存放流的下标而不是流本身
+// PortRings : 每个端口 Slots 个槽位的环形缓冲区, 全部端口共用一整块连续内存, 建好之后不再分配内存
+// PortDeques : 排队区上限不是编译期常数或者没有上限时使用, 每个端口一个 std::deque
+template<int Slots>
+class PortRings {
+	static_assert((Slots & (Slots - 1)) == 0, "Slots must be a power of two");
+
+public:
+	explicit PortRings(int portNum) : slots((size_t) portNum * Slots), heads(portNum, 0), counts(portNum, 0) {}
+
+	bool empty(int port) const {
+		return counts[port] == 0;
+	}
+
+	int size(int port) const {
+		return counts[port];
+	}
+
+	int front(int port) const {
+		return slots[(size_t) port * Slots + heads[port]];
+	}
+
+	void push(int port, int index) {
+		slots[(size_t) port * Slots + ((heads[port] + counts[port]) & (Slots - 1))] = index;
+		++counts[port];
+	}
+
+	void pop(int port) {
+		heads[port] = (heads[port] + 1) & (Slots - 1);
+		--counts[port];
+	}
+
+	// 逐个端口比较排队区中的流, 与环形缓冲区的起点无关
+	bool operator==(const PortRings &other) const {
+		for (size_t port = 0; port < counts.size(); ++port) {
+			if (counts[port] != other.counts[port]) {
+				return false;
+			}
+			for (int i = 0; i < counts[port]; ++i) {
+				if (slots[port * Slots + ((heads[port] + i) & (Slots - 1))] !=
+				    other.slots[port * Slots + ((other.heads[port] + i) & (Slots - 1))]) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+private:
+	std::vector<int32_t> slots;
+	std::vector<int32_t> heads;
+	std::vector<int32_t> counts;
+};
+
+class PortDeques {
+public:
+	explicit PortDeques(int portNum) : queues(portNum) {}
+
+	bool empty(int port) const {
+		return queues[port].empty();
+	}
+
+	int size(int port) const {
+		return (int) queues[port].size();
+	}
+
+	int front(int port) const {
+		return queues[port].front();
+	}
+
+	void push(int port, int index) {
+		queues[port].push_back(index);
+	}
+
+	void pop(int port) {
+		queues[port].pop_front();
+	}
+
+	bool operator==(const PortDeques &other) const {
+		return queues == other.queues;
+	}
+
+private:
+	std::vector<std::deque<int32_t>> queues;
+};
+
+// 不小于 n 的 2 的幂
+constexpr int ringSlots(int n) {
+	int slots = 1;
+	while (slots < n) {
+		slots <<= 1;
+	}
+	return slots;
+}
+
+#endif //ZET_2023_PORT_RINGS_H
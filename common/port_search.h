@@ -0,0 +1,190 @@
+#ifndef ZET_2023_PORT_SEARCH_H
+#define ZET_2023_PORT_SEARCH_H
+
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ZET_PORT_SEARCH_AVX2 1
+#endif
+
+// 端口数量不多 (P <= 64) 时的端口选择引擎
+// 剩余带宽按端口 id 放在对齐的 int32 数组里, 选端口时对所有端口做一次 AVX2 比较 + 取最小, 不再排序和二分
+// 为了和原来 "每次修改后 sort + 二分" 的结果完全一致, 这里维护端口按剩余带宽升序的稳定顺序 (名次):
+// 端口数量不超过 16 时 std::sort 实际是插入排序, 剩余带宽相同的端口保持上一次排序后的相对位置
+// 每个端口的比较键为 remain * 64 + 名次, 剩余带宽相同时选名次靠前的
+class PortSearch {
+public:
+	static constexpr int MAX_PORTS = 64;
+	// 比较键里剩余带宽左移 6 位, 带宽必须小于这个值才能使用
+	static constexpr int MAX_BANDWIDTH = (1 << 25) - 1;
+
+	// descending : 模拟降序数组 + 二分取最后一个满足条件的端口 (solve1), 反过来看就是初始时带宽相同的端口按 id 倒序
+	// 否则模拟升序数组 + 二分取第一个满足条件的端口 (solve2), 初始时带宽相同的端口按 id 顺序
+	PortSearch(const std::vector<int> &bandwidths, bool descending);
+	static bool fits(const std::vector<int> &bandwidths);
+	int remain(int id) const;
+	// 剩余带宽减少 bw (bw 为负数时为释放), 修改后需要调用 commit 更新顺序
+	void modify(int id, int bw);
+	// 端口 id 的剩余带宽已经改完, 按稳定排序的规则把它放到新的位置
+	void commit(int id);
+	int maxRemain() const;
+	// 剩余带宽 >= bw 的端口中剩余带宽最小的一个, 没有返回 -1
+	int bestFit(int bw) const;
+
+private:
+	alignas(32) int32_t remains[MAX_PORTS];
+	alignas(32) int32_t keys[MAX_PORTS];
+	int order[MAX_PORTS];
+	int rank[MAX_PORTS];
+	int portNum;
+	int blocks;
+
+	void setKey(int id);
+	int decode(int32_t key) const;
+	static bool hasAvx2();
+	int32_t minKeyScalar(int32_t threshold) const;
+#ifdef ZET_PORT_SEARCH_AVX2
+	__attribute__((target("avx2"))) int32_t minKeyAvx2(int32_t threshold) const;
+#endif
+};
+
+inline bool PortSearch::fits(const std::vector<int> &bandwidths) {
+	if (bandwidths.empty() || bandwidths.size() > MAX_PORTS) {
+		return false;
+	}
+	for (int bw: bandwidths) {
+		if (bw < 0 || bw > MAX_BANDWIDTH) {
+			return false;
+		}
+	}
+	return true;
+}
+
+inline PortSearch::PortSearch(const std::vector<int> &bandwidths, bool descending) {
+	portNum = (int) bandwidths.size();
+	blocks = (portNum + 7) / 8;
+	for (int i = 0; i < MAX_PORTS; ++i) {
+		// 空位的键为负数, 永远不会被选中
+		remains[i] = -1;
+		keys[i] = INT_MIN;
+	}
+	// 初始顺序: 按带宽稳定排序
+	for (int k = 0; k < portNum; ++k) {
+		int id = descending ? portNum - 1 - k : k;
+		remains[id] = bandwidths[id];
+		int pos = k;
+		while (pos > 0 && remains[order[pos - 1]] > remains[id]) {
+			order[pos] = order[pos - 1];
+			--pos;
+		}
+		order[pos] = id;
+	}
+	for (int pos = 0; pos < portNum; ++pos) {
+		rank[order[pos]] = pos;
+	}
+	for (int i = 0; i < portNum; ++i) {
+		setKey(i);
+	}
+}
+
+inline int PortSearch::remain(int id) const {
+	return remains[id];
+}
+
+inline void PortSearch::modify(int id, int bw) {
+	remains[id] -= bw;
+}
+
+inline void PortSearch::setKey(int id) {
+	keys[id] = remains[id] * MAX_PORTS + rank[id];
+}
+
+inline int PortSearch::decode(int32_t key) const {
+	return order[key & (MAX_PORTS - 1)];
+}
+
+inline void PortSearch::commit(int id) {
+	// 插入排序的效果: 剩余带宽相同的端口之间保持原来的先后顺序
+	int value = remains[id];
+	int old = rank[id];
+	int pos = old;
+	while (pos > 0 && remains[order[pos - 1]] > value) {
+		order[pos] = order[pos - 1];
+		rank[order[pos]] = pos;
+		setKey(order[pos]);
+		--pos;
+	}
+	while (pos + 1 < portNum && remains[order[pos + 1]] < value) {
+		order[pos] = order[pos + 1];
+		rank[order[pos]] = pos;
+		setKey(order[pos]);
+		++pos;
+	}
+	order[pos] = id;
+	rank[id] = pos;
+	setKey(id);
+}
+
+inline bool PortSearch::hasAvx2() {
+#ifdef ZET_PORT_SEARCH_AVX2
+	static const bool supported = __builtin_cpu_supports("avx2");
+	return supported;
+#else
+	return false;
+#endif
+}
+
+inline int32_t PortSearch::minKeyScalar(int32_t threshold) const {
+	int32_t best = INT_MAX;
+	for (int i = 0; i < portNum; ++i) {
+		if (keys[i] >= threshold && keys[i] < best) {
+			best = keys[i];
+		}
+	}
+	return best;
+}
+
+#ifdef ZET_PORT_SEARCH_AVX2
+__attribute__((target("avx2"))) inline int32_t PortSearch::minKeyAvx2(int32_t threshold) const {
+	const __m256i limit = _mm256_set1_epi32(threshold - 1);
+	const __m256i none = _mm256_set1_epi32(INT_MAX);
+	__m256i best = none;
+	for (int b = 0; b < blocks; ++b) {
+		__m256i key = _mm256_load_si256((const __m256i *) (keys + 8 * b));
+		__m256i ok = _mm256_cmpgt_epi32(key, limit);
+		best = _mm256_min_epi32(best, _mm256_blendv_epi8(none, key, ok));
+	}
+	__m128i m = _mm_min_epi32(_mm256_castsi256_si128(best), _mm256_extracti128_si256(best, 1));
+	m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+	m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(m);
+}
+#endif
+
+inline int PortSearch::maxRemain() const {
+	return remains[order[portNum - 1]];
+}
+
+inline int PortSearch::bestFit(int bw) const {
+	// 剩余带宽 >= bw 等价于 key >= bw * 64
+	int32_t threshold = bw <= 0 ? 0 : bw * MAX_PORTS;
+	if (bw > maxRemain()) {
+		return -1;
+	}
+	int32_t key;
+#ifdef ZET_PORT_SEARCH_AVX2
+	if (hasAvx2()) {
+		key = minKeyAvx2(threshold);
+	} else {
+		key = minKeyScalar(threshold);
+	}
+#else
+	key = minKeyScalar(threshold);
+#endif
+	return key == INT_MAX ? -1 : decode(key);
+}
+
+#endif //ZET_2023_PORT_SEARCH_H
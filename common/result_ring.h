@@ -0,0 +1,270 @@
+#ifndef ZET_2023_RESULT_RING_H
+#define ZET_2023_RESULT_RING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 解题程序和检查程序之间的共享内存结果通道 (POSIX shm 环形缓冲区, 单写单读)
+// 每个数据集一个共享内存段, 名字为 "/<name>.<数据集编号>", 由写端创建, 读端读完后删除
+// 协议:
+//   写端把第 seq 条结果写到 records[seq % capacity], 然后用 release 语义发布 writeSeq = seq + 1
+//   读端读到 readSeq 之前的结果后用 release 语义发布 readSeq, 写端据此判断还有多少空位
+//   写端写完后置 closed = 1, 读端在 readSeq == writeSeq 且 closed 时结束
+//   读端提前结束 (如检查出不合法的结果) 时在析构中置 readerClosed = 1, 写端的 push 看到后返回 false, 不再写入;
+//   读端异常退出来不及置位时, 缓冲区满后 readSeq 超过 timeoutMs 没有前进, push 同样返回 false
+//   magic 在头部初始化完成后最后写入, 读端看到 magic 才开始读, 打开后置 readerAttached = 1
+//   共享内存段正常由读端删除; push 失败过, 或写完后 timeoutMs 内没有读端打开时 (finish 返回 false), 由写端在析构中删除,
+//   不会留在 /dev/shm 里
+class ResultRing {
+public:
+	struct Record {
+		int32_t flowid;
+		int32_t portid;
+		int32_t sendtime;
+	};
+
+	~ResultRing();
+	// 写端: 创建共享内存段, capacity 为环形缓冲区能容纳的结果条数 (向上取 2 的幂),
+	// timeoutMs 为等读端腾出空位、等读端打开的最长时间
+	static ResultRing *create(const std::string &name, int dataset, uint32_t capacity = 1u << 20,
+	                          int timeoutMs = 60000);
+	// 读端: 等待写端创建共享内存段, timeoutMs 为负数时一直等 (写端可能要算很久才创建), 超时返回 nullptr
+	static ResultRing *open(const std::string &name, int dataset, int timeoutMs = -1);
+	// 读端已经关闭或长时间不读时返回 false, 之后的结果不会再被读取
+	bool push(int flowid, int portid, int sendtime);
+	// 写端结束, 发布剩余结果并通知读端
+	void close();
+	// 写端: close 之后等读端打开 (最多 timeoutMs), 读端打开过且写端没有放弃时返回 true; 析构时也会调用
+	bool finish();
+	// 读端取一条结果, 写端已结束且没有剩余结果时返回 false
+	bool pop(Record &record);
+
+private:
+	struct alignas(64) Header {
+		char magic[8];
+		uint32_t capacity;
+		uint32_t recordSize;
+		alignas(64) std::atomic<uint64_t> writeSeq;
+		std::atomic<uint32_t> closed;
+		alignas(64) std::atomic<uint64_t> readSeq;
+		std::atomic<uint32_t> readerClosed;
+		std::atomic<uint32_t> readerAttached;
+	};
+
+	static constexpr const char *MAGIC = "ZRING03";
+	// 每攒够这么多条才发布一次 writeSeq / readSeq, 减少两个进程之间的缓存行来回
+	static constexpr uint32_t BATCH = 256;
+
+	std::string path;
+	bool writer;
+	size_t bytes;
+	Header *header;
+	Record *records;
+	uint32_t mask;
+	uint64_t seq;
+	uint64_t limit;
+	int timeoutMs = 0;
+	// 写端: push 失败过, 读端不会再读
+	bool abandoned = false;
+
+	ResultRing(const std::string &path, bool writer, void *memory, size_t bytes);
+	static std::string shmName(const std::string &name, int dataset);
+	static void backoff(int &spins);
+};
+
+inline std::string ResultRing::shmName(const std::string &name, int dataset) {
+	return "/" + name + "." + std::to_string(dataset);
+}
+
+inline ResultRing::ResultRing(const std::string &path, bool writer, void *memory, size_t bytes) {
+	this->path = path;
+	this->writer = writer;
+	this->bytes = bytes;
+	header = (Header *) memory;
+	records = (Record *) ((char *) memory + sizeof(Header));
+	mask = header->capacity - 1;
+	seq = writer ? 0 : header->readSeq.load(std::memory_order_relaxed);
+	limit = writer ? header->capacity : 0;
+}
+
+inline ResultRing::~ResultRing() {
+	// 写端没有送到读端时自己删除共享内存段, 否则由读端删除
+	bool unlink = writer ? !finish() : true;
+	if (!writer) {
+		header->readerClosed.store(1, std::memory_order_release);
+	}
+	munmap(header, bytes);
+	if (unlink) {
+		shm_unlink(path.c_str());
+	}
+}
+
+inline void ResultRing::backoff(int &spins) {
+	// 先忙等一会儿, 再让出 CPU, 最后睡眠, 两个进程在同一个核上时也不会互相卡死
+	if (++spins < 64) {
+		return;
+	}
+	if (spins < 256) {
+		sched_yield();
+		return;
+	}
+	std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+inline ResultRing *ResultRing::create(const std::string &name, int dataset, uint32_t capacity, int timeoutMs) {
+	uint32_t cap = 1;
+	while (cap < capacity) {
+		cap <<= 1;
+	}
+	std::string path = shmName(name, dataset);
+	shm_unlink(path.c_str());
+	int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0) {
+		return nullptr;
+	}
+	size_t bytes = sizeof(Header) + (size_t) cap * sizeof(Record);
+	if (ftruncate(fd, (off_t) bytes) != 0) {
+		::close(fd);
+		shm_unlink(path.c_str());
+		return nullptr;
+	}
+	void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (memory == MAP_FAILED) {
+		shm_unlink(path.c_str());
+		return nullptr;
+	}
+	auto *header = (Header *) memory;
+	header->capacity = cap;
+	header->recordSize = sizeof(Record);
+	header->writeSeq.store(0, std::memory_order_relaxed);
+	header->readSeq.store(0, std::memory_order_relaxed);
+	header->closed.store(0, std::memory_order_relaxed);
+	header->readerClosed.store(0, std::memory_order_relaxed);
+	header->readerAttached.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(header->magic, MAGIC, sizeof(header->magic));
+	auto *ring = new ResultRing(path, true, memory, bytes);
+	ring->timeoutMs = timeoutMs;
+	return ring;
+}
+
+inline ResultRing *ResultRing::open(const std::string &name, int dataset, int timeoutMs) {
+	std::string path = shmName(name, dataset);
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	int spins = 0;
+	while (true) {
+		int fd = shm_open(path.c_str(), O_RDWR, 0600);
+		if (fd >= 0) {
+			struct stat st{};
+			if (fstat(fd, &st) == 0 && (size_t) st.st_size > sizeof(Header)) {
+				void *memory = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+				::close(fd);
+				if (memory == MAP_FAILED) {
+					return nullptr;
+				}
+				auto *header = (Header *) memory;
+				if (memcmp(header->magic, MAGIC, sizeof(header->magic)) == 0 &&
+				    header->recordSize == sizeof(Record)) {
+					std::atomic_thread_fence(std::memory_order_acquire);
+					header->readerAttached.store(1, std::memory_order_release);
+					return new ResultRing(path, false, memory, st.st_size);
+				}
+				munmap(memory, st.st_size);
+			} else {
+				::close(fd);
+			}
+		}
+		if (timeoutMs >= 0 && std::chrono::steady_clock::now() > deadline) {
+			return nullptr;
+		}
+		backoff(spins);
+	}
+}
+
+inline bool ResultRing::push(int flowid, int portid, int sendtime) {
+	if (seq == limit) {
+		// 缓冲区满, 先把已写的发布出去, 等读端腾出空位
+		header->writeSeq.store(seq, std::memory_order_release);
+		int spins = 0;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+		while ((limit = header->readSeq.load(std::memory_order_acquire) + header->capacity) == seq) {
+			if (header->readerClosed.load(std::memory_order_acquire) ||
+			    (spins >= 256 && std::chrono::steady_clock::now() > deadline)) {
+				abandoned = true;
+				return false;
+			}
+			backoff(spins);
+		}
+	}
+	records[seq & mask] = {flowid, portid, sendtime};
+	if ((++seq & (BATCH - 1)) == 0) {
+		header->writeSeq.store(seq, std::memory_order_release);
+		if (header->readerClosed.load(std::memory_order_relaxed)) {
+			abandoned = true;
+			return false;
+		}
+	}
+	return true;
+}
+
+inline void ResultRing::close() {
+	if (!writer || header->closed.load(std::memory_order_relaxed)) {
+		return;
+	}
+	header->writeSeq.store(seq, std::memory_order_release);
+	header->closed.store(1, std::memory_order_release);
+}
+
+inline bool ResultRing::finish() {
+	if (!writer) {
+		return false;
+	}
+	close();
+	// 结果都在缓冲区里时写端可能比读端先写完, 等读端打开
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	int spins = 0;
+	while (!abandoned && !header->readerAttached.load(std::memory_order_acquire)) {
+		if (spins >= 256 && std::chrono::steady_clock::now() > deadline) {
+			abandoned = true;
+			break;
+		}
+		backoff(spins);
+	}
+	return !abandoned;
+}
+
+inline bool ResultRing::pop(Record &record) {
+	if (seq == limit) {
+		header->readSeq.store(seq, std::memory_order_release);
+		int spins = 0;
+		while (true) {
+			// 先读 closed 再读 writeSeq, 保证 closed 之前发布的结果都能看到
+			bool closed = header->closed.load(std::memory_order_acquire);
+			limit = header->writeSeq.load(std::memory_order_acquire);
+			if (limit != seq) {
+				break;
+			}
+			if (closed) {
+				return false;
+			}
+			backoff(spins);
+		}
+	}
+	record = records[seq & mask];
+	if ((++seq & (BATCH - 1)) == 0) {
+		header->readSeq.store(seq, std::memory_order_release);
+	}
+	return true;
+}
+
+#endif //ZET_2023_RESULT_RING_H
@@ -0,0 +1,75 @@
+#ifndef ZET_2023_RULES_H
+#define ZET_2023_RULES_H
+
+#include "port_rings.h"
+
+// 比赛规则中的常数
+//   缓存区容量 = bufferFactor * 端口数
+//   端口排队区容量 = queueLimit, 超出的流被丢弃, 罚时 = penalty * 发送所需时间
+//   queueing = false 为 solve1 / determine_1 的规则: 没有排队区上限和缓存区上限, 也没有罚时
+// 调度和检查核心以规则类型为模板参数, 常数在编译期确定, 排队区使用定长环形缓冲区, 用不到的分支直接被编译掉
+template<int BufferFactor, int QueueLimit, int Penalty, bool Queueing>
+struct Rules {
+	static constexpr bool fixed = true;
+	static constexpr bool queueing = Queueing;
+	static constexpr int bufferFactor = BufferFactor;
+	static constexpr int queueLimit = QueueLimit;
+	static constexpr int penalty = Penalty;
+};
+
+// 比赛规则 (solve2 / determine_2)
+using StandardRules = Rules<20, 30, 2, true>;
+// solve1 / determine_1 的规则
+using NoQueueRules = Rules<0, 0, 0, false>;
+
+// 运行时给出的规则, 用于选择模板实例
+struct RuleSet {
+	int bufferFactor = StandardRules::bufferFactor;
+	int queueLimit = StandardRules::queueLimit;
+	int penalty = StandardRules::penalty;
+	bool queueing = StandardRules::queueing;
+};
+
+// 常数不是编译期已知的规则, 排队区退回 PortDeques
+struct DynamicRules {
+	static constexpr bool fixed = false;
+	static constexpr bool queueing = true;
+	int bufferFactor;
+	int queueLimit;
+	int penalty;
+
+	explicit DynamicRules(const RuleSet &rules) {
+		bufferFactor = rules.bufferFactor;
+		queueLimit = rules.queueLimit;
+		penalty = rules.penalty;
+	}
+};
+
+// 规则 R 下所有端口的排队区: 常数已知时每个端口为 queueLimit 向上取 2 的幂个槽位的环形缓冲区 (比赛规则为 32)
+template<class R, bool = R::fixed && R::queueing>
+struct PortQueuesOf {
+	using type = PortDeques;
+};
+
+template<class R>
+struct PortQueuesOf<R, true> {
+	using type = PortRings<ringSlots(R::queueLimit)>;
+};
+
+template<class R>
+using PortQueues = typename PortQueuesOf<R>::type;
+
+// 按运行时规则选择模板实例并调用 f(rules)
+template<class F>
+decltype(auto) withRules(const RuleSet &rules, F &&f) {
+	if (!rules.queueing) {
+		return f(NoQueueRules());
+	}
+	if (rules.bufferFactor == StandardRules::bufferFactor && rules.queueLimit == StandardRules::queueLimit &&
+	    rules.penalty == StandardRules::penalty) {
+		return f(StandardRules());
+	}
+	return f(DynamicRules(rules));
+}
+
+#endif //ZET_2023_RULES_H
@@ -0,0 +1,652 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <list>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <set>
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../solve2/transfer.h"
+#include "../determine_2/checker.h"
+
+using namespace std;
+
+// 常驻调度服务: 启动时把所有数据集读进内存, 之后通过 Unix 域套接字接收请求, 省掉每次评估的进程启动和读文件开销
+// 请求为一行文本, 回复第一行为 "ok ..." 或 "error ...", 一个连接上可以连续发送多个请求
+//   datasets                               -> ok <数量>, 之后每个数据集一行 N,流数量,端口数量
+//   schedule N a b [c] [csv|bin]           -> ok <transfer返回值> <检查器分数> <结果条数> [原因], 之后为结果 (csv 每行 flow,port,time; bin 为 "ZRS1" + int32 三元组)
+//   score N <条数> [csv|bin]               -> 请求行之后紧跟结果数据, 回复 ok <检查器分数> [原因], 0 表示结果不合法 (与 determine_2 相同)
+//   sweep N a0 a1 da b0 b1 db [c]          -> 在线程池上并行扫描权重网格, 每组一行 a,b,分数, 最后一行 best,a,b,分数 (不合法的组分数为 0, 不附原因)
+//   quit                                   -> 关闭连接
+//   shutdown                               -> 停止服务, 正在进行的 sweep 不再计算剩下的网格, 其他连接都被关闭
+// 分数为 0 时 schedule / score 的回复行末尾附上检查器给出的原因, 检查器的信息不会写到服务的标准输出
+// score 的条数不能超过数据集的流数量, sweep 的网格不能超过 maxSweep 组, 否则回复 error (score 之后连接被关闭, 后面的结果数据无法再对齐)
+
+// 一个数据集, solver 和 checker 各保留一份只读的原始数据, 每次请求从这里复制
+class Dataset {
+public:
+	list<solver::Flow> flows;
+	vector<solver::Port> ports;
+	vector<checker::Flow> checkFlows;
+	vector<checker::Port> checkPorts;
+	int maxcachesize = 0;
+};
+
+// 每个线程预先分配好的工作区, 数据集大小不变时重复使用, 不再重新分配
+class Arena {
+public:
+	vector<vector<int>> results;
+	vector<checker::Flow> flows;
+	vector<checker::Port> ports;
+	vector<checker::Result> res;
+};
+
+thread_local Arena arena;
+
+// 固定数量的工作线程, 服务运行期间一直保持
+class ThreadPool {
+public:
+	explicit ThreadPool(int n);
+	~ThreadPool();
+	// 把 [0, n) 分给线程池和调用线程一起执行, 全部完成后返回; cancel 变为 true 后剩下的下标不再执行
+	void parallelFor(int n, const function<void(int)> &fn, const atomic<bool> *cancel = nullptr);
+
+private:
+	vector<thread> workers;
+	list<function<void()>> tasks;
+	mutex lock;
+	condition_variable cv;
+	bool stopping;
+};
+
+ThreadPool::ThreadPool(int n) {
+	stopping = false;
+	for (int i = 0; i < n; ++i) {
+		workers.emplace_back([this]() {
+			while (true) {
+				function<void()> task;
+				{
+					unique_lock<mutex> guard(lock);
+					cv.wait(guard, [this]() { return stopping || !tasks.empty(); });
+					if (tasks.empty()) {
+						return;
+					}
+					task = move(tasks.front());
+					tasks.pop_front();
+				}
+				task();
+			}
+		});
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	cv.notify_all();
+	for (auto &worker: workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::parallelFor(int n, const function<void(int)> &fn, const atomic<bool> *cancel) {
+	// 调用线程自己也领任务, 即使所有工作线程都在忙也不会卡住
+	auto next = make_shared<atomic<int>>(0);
+	auto done = make_shared<atomic<int>>(0);
+	auto finished = make_shared<condition_variable>();
+	auto finishedLock = make_shared<mutex>();
+	auto run = [=, &fn]() {
+		int i;
+		while ((i = (*next)++) < n) {
+			// 取消后仍然领完剩下的下标, 只是不执行, 这样等待的条件不变
+			if (cancel == nullptr || !*cancel) {
+				fn(i);
+			}
+			if (++*done == n) {
+				lock_guard<mutex> guard(*finishedLock);
+				finished->notify_all();
+			}
+		}
+	};
+	int helpers = min((int) workers.size(), n - 1);
+	{
+		lock_guard<mutex> guard(lock);
+		for (int i = 0; i < helpers; ++i) {
+			tasks.emplace_back(run);
+		}
+	}
+	cv.notify_all();
+	run();
+	unique_lock<mutex> guard(*finishedLock);
+	finished->wait(guard, [&]() { return done->load() == n; });
+}
+
+vector<Dataset> datasets;
+ThreadPool *pool = nullptr;
+atomic<bool> stopping(false);
+string socketPath;
+// sweep 一次最多计算的网格数量
+const long long maxSweep = 1 << 20;
+// 所有打开的连接, shutdown 时关闭其他连接, 让阻塞在 read 上的连接线程退出
+mutex connectionsLock;
+set<int> openConnections;
+
+void loadDatasets(const string &root) {
+	auto lambda = [](solver::Flow &first, solver::Flow &second) {
+		if (first.startTime != second.startTime) {
+			return first.startTime < second.startTime;
+		} else if (first.bandwidth != second.bandwidth) {
+			return first.bandwidth < second.bandwidth;
+		} else {
+			return first.sendTime < second.sendTime;
+		}
+	};
+	for (int No = 0;; ++No) {
+		string path = root + "/" + to_string(No);
+		Dataset dataset;
+		vector<checker::Result> res;
+		if (!checker::Input(path, dataset.checkFlows, dataset.checkPorts, res, dataset.maxcachesize, false)) {
+			break;
+		}
+		solver::loadFlow((path + "/flow.txt").c_str(), dataset.flows);
+		solver::loadPort((path + "/port.txt").c_str(), dataset.ports);
+		dataset.flows.sort(lambda);
+		datasets.push_back(move(dataset));
+	}
+}
+
+// 用 solve2 的调度核心计算一组权重, 结果留在当前线程的 arena.results 里
+int schedule(const Dataset &dataset, double a, double b, double c) {
+	auto flowsNum = dataset.flows.size();
+	if (arena.results.size() != flowsNum) {
+		arena.results.assign(flowsNum, vector<int>(3));
+	}
+	return solver::transfer(dataset.flows, dataset.ports, arena.results, a, b, c);
+}
+
+// 用 determine_2 的检查核心给 arena.res 打分, arena.res 必须已按发送时间排好序
+// 检查器的出错信息不写到服务的标准输出, message 不为空时放在一行里交给调用者回复给客户端
+int check(const Dataset &dataset, string *message = nullptr) {
+	arena.flows = dataset.checkFlows;
+	arena.ports = dataset.checkPorts;
+	ostringstream out;
+	checker::errorstream() = &out;
+	int score = checker::algorithm(arena.flows, arena.ports, arena.res);
+	checker::errorstream() = &cout;
+	if (message != nullptr) {
+		*message = out.str();
+		while (!message->empty() && message->back() == '\n') {
+			message->pop_back();
+		}
+		replace(message->begin(), message->end(), '\n', ' ');
+	}
+	return score;
+}
+
+// solve2 的结果本身就按发送时间非递减, 直接转成检查器的格式
+void resultsToCheck() {
+	arena.res.clear();
+	for (const auto &r: arena.results) {
+		arena.res.emplace_back(r[0], r[1], r[2]);
+	}
+}
+
+// 带缓冲的套接字读写
+class Connection {
+public:
+	explicit Connection(int fd);
+	~Connection();
+	bool readLine(string &line);
+	bool readExact(char *out, size_t n);
+	void write(const char *data, size_t n);
+	void write(const string &s);
+	void flush();
+
+private:
+	int fd;
+	vector<char> in;
+	size_t inPos;
+	size_t inLen;
+	string out;
+	bool fill();
+};
+
+Connection::Connection(int fd) : in(1 << 16) {
+	this->fd = fd;
+	inPos = 0;
+	inLen = 0;
+	lock_guard<mutex> guard(connectionsLock);
+	openConnections.insert(fd);
+}
+
+Connection::~Connection() {
+	flush();
+	{
+		// 先移出再关闭, 避免 shutdown 关到被重新分配的描述符
+		lock_guard<mutex> guard(connectionsLock);
+		openConnections.erase(fd);
+	}
+	close(fd);
+}
+
+bool Connection::fill() {
+	inPos = 0;
+	ssize_t n = read(fd, in.data(), in.size());
+	inLen = n > 0 ? (size_t) n : 0;
+	return n > 0;
+}
+
+bool Connection::readLine(string &line) {
+	line.clear();
+	while (true) {
+		if (inPos == inLen && !fill()) {
+			return !line.empty();
+		}
+		char *begin = in.data() + inPos;
+		char *end = (char *) memchr(begin, '\n', inLen - inPos);
+		if (end != nullptr) {
+			line.append(begin, end);
+			inPos += end - begin + 1;
+			if (!line.empty() && line.back() == '\r') {
+				line.pop_back();
+			}
+			return true;
+		}
+		line.append(begin, inLen - inPos);
+		inPos = inLen;
+	}
+}
+
+bool Connection::readExact(char *dst, size_t n) {
+	while (n > 0) {
+		if (inPos == inLen && !fill()) {
+			return false;
+		}
+		size_t k = min(n, inLen - inPos);
+		memcpy(dst, in.data() + inPos, k);
+		inPos += k;
+		dst += k;
+		n -= k;
+	}
+	return true;
+}
+
+void Connection::write(const char *data, size_t n) {
+	out.append(data, n);
+	if (out.size() >= (1 << 16)) {
+		flush();
+	}
+}
+
+void Connection::write(const string &s) {
+	write(s.data(), s.size());
+}
+
+void Connection::flush() {
+	size_t pos = 0;
+	while (pos < out.size()) {
+		ssize_t n = ::write(fd, out.data() + pos, out.size() - pos);
+		if (n <= 0) {
+			break;
+		}
+		pos += n;
+	}
+	out.clear();
+}
+
+bool getDataset(istringstream &args, Connection &conn, int &No) {
+	if (!(args >> No) || No < 0 || No >= (int) datasets.size()) {
+		conn.write("error 数据集不存在\n");
+		return false;
+	}
+	return true;
+}
+
+void handleSchedule(istringstream &args, Connection &conn) {
+	int No;
+	double a, b, c = 0;
+	string format = "csv";
+	if (!getDataset(args, conn, No)) {
+		return;
+	}
+	if (!(args >> a >> b)) {
+		conn.write("error 缺少权重\n");
+		return;
+	}
+	string token;
+	while (args >> token) {
+		if (token == "csv" || token == "bin") {
+			format = token;
+		} else {
+			c = atof(token.c_str());
+		}
+	}
+	int ret = schedule(datasets[No], a, b, c);
+	resultsToCheck();
+	string message;
+	int score = check(datasets[No], &message);
+	conn.write("ok " + to_string(ret) + " " + to_string(score) + " " + to_string(arena.results.size()) +
+	           (score == 0 && !message.empty() ? " " + message : "") + "\n");
+	if (format == "bin") {
+		conn.write("ZRS1", 4);
+		for (const auto &r: arena.results) {
+			conn.write((const char *) r.data(), sizeof(int) * 3);
+		}
+	} else {
+		char line[48];
+		for (const auto &r: arena.results) {
+			int n = snprintf(line, sizeof(line), "%d,%d,%d\n", r[0], r[1], r[2]);
+			conn.write(line, n);
+		}
+	}
+}
+
+// 返回 false 时结果数据没有读完, 连接需要关闭
+bool handleScore(istringstream &args, Connection &conn) {
+	int No;
+	long long count;
+	string format = "csv";
+	if (!getDataset(args, conn, No)) {
+		return false;
+	}
+	if (!(args >> count) || count < 0) {
+		conn.write("error 缺少结果条数\n");
+		return false;
+	}
+	// 每个流只有一条结果, 更多的条数一定不合法, 也不能按它分配缓冲区
+	if (count > (long long) datasets[No].checkFlows.size()) {
+		conn.write("error 结果条数超过流数量\n");
+		return false;
+	}
+	args >> format;
+	arena.res.clear();
+	if (format == "bin") {
+		char magic[4];
+		vector<int> rec(3 * count);
+		if (!conn.readExact(magic, 4) || memcmp(magic, "ZRS1", 4) != 0 ||
+		    !conn.readExact((char *) rec.data(), rec.size() * sizeof(int))) {
+			conn.write("error 二进制结果格式有误\n");
+			return false;
+		}
+		for (long long i = 0; i < count; ++i) {
+			arena.res.emplace_back(rec[3 * i], rec[3 * i + 1], rec[3 * i + 2]);
+		}
+	} else {
+		string line;
+		for (long long i = 0; i < count; ++i) {
+			int f, p, t;
+			if (!conn.readLine(line) || sscanf(line.c_str(), "%d,%d,%d", &f, &p, &t) != 3) {
+				conn.write("error 结果格式有误\n");
+				return false;
+			}
+			arena.res.emplace_back(f, p, t);
+		}
+	}
+	stable_sort(arena.res.begin(), arena.res.end(),
+	            [](const checker::Result &x, const checker::Result &y) { return x.sendtime < y.sendtime; });
+	string message;
+	int score = check(datasets[No], &message);
+	conn.write("ok " + to_string(score) + (score == 0 && !message.empty() ? " " + message : "") + "\n");
+	return true;
+}
+
+void handleSweep(istringstream &args, Connection &conn) {
+	int No;
+	double a0, a1, da, b0, b1, db, c = 0;
+	if (!getDataset(args, conn, No)) {
+		return;
+	}
+	if (!(args >> a0 >> a1 >> da >> b0 >> b1 >> db) || da <= 0 || db <= 0) {
+		conn.write("error 网格参数有误\n");
+		return;
+	}
+	args >> c;
+	// 与 test.sh 相同, 两端都包含; 用整数下标避免浮点累加误差
+	// 先用浮点数判断大小, 网格过大 (或参数为 inf / nan) 时不转换成整数, 避免溢出
+	double sa = floor((a1 - a0) / da + 1e-9) + 1;
+	double sb = floor((b1 - b0) / db + 1e-9) + 1;
+	if (!(sa <= (double) maxSweep && sb <= (double) maxSweep)) {
+		conn.write("error 网格超过 " + to_string(maxSweep) + " 组\n");
+		return;
+	}
+	long long na = max((long long) sa, 0LL);
+	long long nb = max((long long) sb, 0LL);
+	if (na * nb > maxSweep) {
+		conn.write("error 网格超过 " + to_string(maxSweep) + " 组\n");
+		return;
+	}
+	int n = (int) (na * nb);
+	vector<int> scores(n);
+	const Dataset &dataset = datasets[No];
+	pool->parallelFor(n, [&](int k) {
+		schedule(dataset, a0 + (k / nb) * da, b0 + (k % nb) * db, c);
+		resultsToCheck();
+		scores[k] = check(dataset);
+	}, &stopping);
+	if (stopping) {
+		conn.write("error 服务正在停止\n");
+		return;
+	}
+	conn.write("ok " + to_string(n) + "\n");
+	int bestK = -1;
+	char line[96];
+	for (int k = 0; k < n; ++k) {
+		double a = a0 + (k / nb) * da;
+		double b = b0 + (k % nb) * db;
+		int len = snprintf(line, sizeof(line), "%g,%g,%d\n", a, b, scores[k]);
+		conn.write(line, len);
+		if (scores[k] > 0 && (bestK < 0 || scores[k] < scores[bestK])) {
+			bestK = k;
+		}
+	}
+	if (bestK >= 0) {
+		int len = snprintf(line, sizeof(line), "best,%g,%g,%d\n", a0 + (bestK / nb) * da, b0 + (bestK % nb) * db,
+		                   scores[bestK]);
+		conn.write(line, len);
+	} else {
+		conn.write("best,,,0\n");
+	}
+}
+
+void serve(int fd) {
+	Connection conn(fd);
+	string line;
+	while (!stopping && conn.readLine(line)) {
+		istringstream args(line);
+		string cmd;
+		args >> cmd;
+		if (cmd.empty()) {
+			continue;
+		} else if (cmd == "datasets") {
+			conn.write("ok " + to_string(datasets.size()) + "\n");
+			for (int i = 0; i < (int) datasets.size(); ++i) {
+				conn.write(to_string(i) + "," + to_string(datasets[i].flows.size()) + "," +
+				           to_string(datasets[i].ports.size()) + "\n");
+			}
+		} else if (cmd == "schedule") {
+			handleSchedule(args, conn);
+		} else if (cmd == "score") {
+			if (!handleScore(args, conn)) {
+				break;
+			}
+		} else if (cmd == "sweep") {
+			handleSweep(args, conn);
+		} else if (cmd == "quit") {
+			break;
+		} else if (cmd == "shutdown") {
+			conn.write("ok\n");
+			conn.flush();
+			stopping = true;
+			{
+				// 其他连接可能阻塞在 read 上, 关闭读写让它们退出
+				lock_guard<mutex> guard(connectionsLock);
+				for (int other: openConnections) {
+					if (other != fd) {
+						::shutdown(other, SHUT_RDWR);
+					}
+				}
+			}
+			// 唤醒阻塞在 accept 上的主线程
+			int wake = socket(AF_UNIX, SOCK_STREAM, 0);
+			sockaddr_un addr{};
+			addr.sun_family = AF_UNIX;
+			strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+			connect(wake, (sockaddr *) &addr, sizeof(addr));
+			close(wake);
+			break;
+		} else {
+			conn.write("error 未知请求 " + cmd + "\n");
+		}
+		conn.flush();
+	}
+}
+
+int runServer(const string &root, int jobs) {
+	loadDatasets(root);
+	if (datasets.empty()) {
+		cerr << "找不到数据集 " << root << endl;
+		return 1;
+	}
+	ThreadPool threads(jobs - 1);
+	pool = &threads;
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+	unlink(socketPath.c_str());
+	if (bind(listener, (sockaddr *) &addr, sizeof(addr)) != 0 || listen(listener, 64) != 0) {
+		cerr << "无法监听 " << socketPath << "：" << strerror(errno) << endl;
+		return 1;
+	}
+	cerr << "已加载 " << datasets.size() << " 个数据集，监听 " << socketPath << endl;
+	// 每个连接一个线程, 已结束的连接在下一次 accept 时回收
+	list<pair<thread, shared_ptr<atomic<bool>>>> connections;
+	// 文件描述符或内存耗尽时 accept 会立即再次失败, 等待一段时间 (10 毫秒起, 每次翻倍, 最多 1 秒) 再试, 不空转;
+	// 其他错误 (监听套接字已失效等) 无法恢复, 停止服务
+	int backoff = 0;
+	int status = 0;
+	while (!stopping) {
+		int fd = accept(listener, nullptr, nullptr);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+				if (backoff == 0) {
+					cerr << "accept 失败：" << strerror(errno) << "，稍后重试" << endl;
+				}
+				backoff = min(max(backoff * 2, 10), 1000);
+				this_thread::sleep_for(chrono::milliseconds(backoff));
+				continue;
+			}
+			cerr << "accept 失败：" << strerror(errno) << "，停止服务" << endl;
+			status = 1;
+			stopping = true;
+			// 与 shutdown 请求相同, 关闭其他连接, 不等客户端自己断开
+			lock_guard<mutex> guard(connectionsLock);
+			for (int other: openConnections) {
+				::shutdown(other, SHUT_RDWR);
+			}
+			break;
+		}
+		backoff = 0;
+		if (stopping) {
+			close(fd);
+			break;
+		}
+		for (auto it = connections.begin(); it != connections.end();) {
+			if (*it->second) {
+				it->first.join();
+				it = connections.erase(it);
+			} else {
+				++it;
+			}
+		}
+		auto done = make_shared<atomic<bool>>(false);
+		connections.emplace_back(thread([fd, done]() {
+			serve(fd);
+			*done = true;
+		}), done);
+	}
+	for (auto &connection: connections) {
+		connection.first.join();
+	}
+	close(listener);
+	unlink(socketPath.c_str());
+	pool = nullptr;
+	return status;
+}
+
+// 简单客户端: 发送一行请求, score 请求的结果数据从标准输入转发, 回复原样打印到标准输出
+int runClient(const string &request) {
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+	if (connect(fd, (sockaddr *) &addr, sizeof(addr)) != 0) {
+		cerr << "无法连接 " << socketPath << "：" << strerror(errno) << endl;
+		return 1;
+	}
+	string line = request + "\n";
+	::write(fd, line.data(), line.size());
+	if (request.compare(0, 6, "score ") == 0) {
+		char buf[1 << 16];
+		ssize_t n;
+		while ((n = read(STDIN_FILENO, buf, sizeof(buf))) > 0) {
+			::write(fd, buf, n);
+		}
+	}
+	::write(fd, "quit\n", 5);
+	char buf[1 << 16];
+	ssize_t n;
+	while ((n = read(fd, buf, sizeof(buf))) > 0) {
+		fwrite(buf, 1, n, stdout);
+	}
+	close(fd);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	// ./daemon --socket /tmp/zet.sock [--root ../data] [--jobs N]
+	// ./daemon --client /tmp/zet.sock "sweep 0 -10 10 0.1 -10 10 0.1"
+	string root = "../data";
+	string request;
+	bool client = false;
+	int jobs = (int) thread::hardware_concurrency();
+	socketPath = "/tmp/zet_2023.sock";
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+			socketPath = argv[++i];
+		} else if (strcmp(argv[i], "--client") == 0 && i + 2 < argc) {
+			client = true;
+			socketPath = argv[++i];
+			request = argv[++i];
+		} else if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
+			root = argv[++i];
+		} else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+			jobs = atoi(argv[++i]);
+		}
+	}
+	signal(SIGPIPE, SIG_IGN);
+	if (client) {
+		return runClient(request);
+	}
+	return runServer(root, max(jobs, 1));
+}
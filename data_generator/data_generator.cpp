@@ -2,6 +2,8 @@
 #include <iostream>
 #include <sys/stat.h>
 #include <chrono>
+#include <cstring>
+#include <cstdlib>
 
 using namespace std;
 int portnum = 0;
@@ -35,13 +37,40 @@ void Output(string &path, int &No) {
 	output.close();
 
 }
-int main() {
+int main(int argc, char *argv[]) {
 	int No = 0;
 	string path;
 	int seed = std::chrono::system_clock::now().time_since_epoch().count();
+	// 可选参数, 不指定时与原来相同: 生成 ../data/0 ~ ../data/9, 流和端口数量随机
+	// --root 输出目录  --count 数据集数量  --flows 流数量  --ports 端口数量  --seed 随机种子
+	// --begin 流最大开始时间  --send 流最大发送所需时间 (时间跨度远大于发送时间的数据用于 solve2 --warp)
+	string root = "../data";
+	int count = 10;
+	int flows = 0;
+	int ports = 0;
+	int begin = 0;
+	int send = 0;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (strcmp(argv[i], "--root") == 0) {
+			root = argv[i + 1];
+		} else if (strcmp(argv[i], "--count") == 0) {
+			count = atoi(argv[i + 1]);
+		} else if (strcmp(argv[i], "--flows") == 0) {
+			flows = atoi(argv[i + 1]);
+		} else if (strcmp(argv[i], "--ports") == 0) {
+			ports = atoi(argv[i + 1]);
+		} else if (strcmp(argv[i], "--begin") == 0) {
+			begin = atoi(argv[i + 1]);
+		} else if (strcmp(argv[i], "--send") == 0) {
+			send = atoi(argv[i + 1]);
+		} else if (strcmp(argv[i], "--seed") == 0) {
+			seed = atoi(argv[i + 1]);
+		}
+	}
 	srand(seed);
-	for (No = 0; No < 10; No++) {
-		path = "../data/" + to_string(No);
+	mkdir(root.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+	for (No = 0; No < count; No++) {
+		path = root + "/" + to_string(No);
 
 		mkdir(path.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
 		portnum = rand() % 10 + 5;//端口数量5-14
@@ -49,6 +78,14 @@ int main() {
 		flownum *= 5000;//流数量5000-14000
 		bg = rand() % 50 + 50;//流最大开始时间50-99
 		et = rand() % 50 + 50;//流最大需要时间50-99
+		if (ports > 0)
+			portnum = ports;
+		if (flows > 0)
+			flownum = flows;
+		if (begin > 0)
+			bg = begin;
+		if (send > 0)
+			et = send;
 		Output(path, No);
 	}
-}
\ No newline at end of file
+}
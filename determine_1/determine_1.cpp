@@ -3,10 +3,19 @@
 #include <vector>
 #include <string>
 #include <algorithm>
-#include <map>
 #include <deque>
+#include <queue>
 #include <iomanip>
+#include <sstream>
 #include <cmath>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include "../common/result_ring.h"
+#include "../common/lower_bound.h"
 
 using namespace std;
 
@@ -26,7 +35,6 @@ public:
 	int id;
 	int speed;
 	int maxspeed;
-	multimap<int, Flow> flowqueue;
 	deque<Flow> waitqueue;
 	Port(int i, int s);
 };
@@ -58,8 +66,14 @@ Result::Result(int f, int p, int s) {
 	sendtime = s;
 }
 
+/*检查的出错信息写到这里，默认为标准输出；线程局部，并行评分时每个线程换成自己的ostringstream*/
+ostream *&errorstream() {
+	thread_local ostream *out = &cout;
+	return out;
+}
+
 /*负责数据的输入部分，将两个文件里的数据读入处理*/
-bool Input(string path, vector<Flow> &flows, vector<Port> &ports, vector<Result> &results) {
+bool Input(string path, vector<Flow> &flows, vector<Port> &ports, vector<Result> &results, bool readresult = true) {
 	ifstream input;
 	int allspeed = 0;
 	int alltime = 0;
@@ -114,9 +128,11 @@ bool Input(string path, vector<Flow> &flows, vector<Port> &ports, vector<Result>
 	//cout << "流占用时间平均值：" << alltime / double(flowcount) << endl;
 	//cout << endl;
 	/*port输入完毕*/
+	if (!readresult)
+		return true;
 	input.open(path3, ios::in);
 	if (!input.is_open()) {
-		cout << "找不到结果文件" << endl;
+		*errorstream() << "找不到结果文件" << endl;
 		return false;
 	}
 
@@ -131,90 +147,74 @@ bool Input(string path, vector<Flow> &flows, vector<Port> &ports, vector<Result>
 
 	return true;
 }
-/*更新端口状态*/
+/*更新端口状态：事件驱动，不再逐个时刻扫描所有端口
+ *各端口互不影响，每个端口按排队顺序依次发送：队首在 max(当前时刻, 发送时间) 时放得下就开始发送，
+ *放不下就直接跳到下一个流发送完毕、释放带宽的时刻，不经过中间空闲的时刻
+ *流在开始时刻 s 发送、占用 needtime 时，在 max(s + needtime, s + 1) 时刻释放（每个时刻先释放再发送，本时刻开始的流最早下一时刻释放）
+ *与逐时刻模拟相同，循环在所有排队区都已清空的那个时刻结束，总时间为 该时刻 + 1 与 所有流的 s + needtime 中的最大值*/
 int updateport(vector<Port> &ports) {
-	int time = 0;
-	while (true)//循环直到所有端口都没有待发送的流
-	{
-		int waitqueueemptycount = 0;
-		for (auto &port: ports)//对每个端口进行处理
-		{
-			if (port.waitqueue.empty())//这个端口已经没有待发送的流了
-				++waitqueueemptycount;
-
-			for (auto j = port.flowqueue.begin(); j != port.flowqueue.end();)//对端口中已发送的流检查是否发送完毕
-			{
-				if (j->first > time)//map为升序 所以最小值大于当前时间就代表没有发送完毕的流了
+	int lastsend = -1;//所有端口中最后一个流开始发送的时刻
+	int maxend = 0;
+	priority_queue<pair<int, int>, vector<pair<int, int>>, greater<>> sending;//正在发送的流：释放时刻、带宽
+	for (auto &port: ports) {
+		int time = 0;
+		while (!port.waitqueue.empty()) {
+			const Flow &flow = port.waitqueue.front();
+			time = max(time, flow.sendtime);
+			while (true) {
+				while (!sending.empty() && sending.top().first <= time)//释放发送完毕的流
 				{
-					break;
-				} else//反之还有发送完毕的流 把它占用的端口腾出来
-				{
-					port.speed += j->second.speed;//将端口带宽还原回去
-					port.flowqueue.erase(j);//在在缓冲区中删除
-					j = port.flowqueue.begin();
+					port.speed += sending.top().second;
+					sending.pop();
 				}
-			}
-			while (!port.waitqueue.empty() &&
-			       port.waitqueue.front().sendtime <= time)//对每个端口中等待队列发送时间小于等于当前时间的流检测一遍是否能发送
-			{
-				if (port.waitqueue.front().speed <= port.speed)//端口剩余空间足够，可以发送
-				{
-					port.flowqueue.insert(pair<int, Flow>(time + port.waitqueue.front().needtime,
-					                                      port.waitqueue.front()));//将这个流放入已发送队列
-					port.speed -= port.waitqueue.front().speed;//将端口可用空间减去流需要占用的空间
-					port.waitqueue.pop_front();//出等待队列
-				} else {
+				if (flow.speed <= port.speed)
 					break;
-				}
+				time = sending.top().first;//放不下，跳到下一个释放时刻
 			}
+			port.speed -= flow.speed;
+			sending.emplace(time + max(flow.needtime, 1), flow.speed);
+			maxend = max(maxend, time + flow.needtime);
+			lastsend = max(lastsend, time);
+			port.waitqueue.pop_front();
 		}
-		++time;
-		if (waitqueueemptycount == ports.size())
-			break;
-	}
-	int maxtime = time;
-	for (auto &port: ports)//遍历所有端口已发送的队列，找到最晚发送完毕的时间并返回
-	{
-		if (port.flowqueue.empty())
-			continue;
-		else {
-			auto last = port.flowqueue.end();
-			--last;
-			maxtime = max(maxtime, last->first);
+		while (!sending.empty())//端口之间互不影响，下一个端口从空闲开始
+		{
+			port.speed += sending.top().second;
+			sending.pop();
 		}
 	}
-	return maxtime;
+	return max(lastsend + 2, maxend);
 }
 /*数据处理*/
 int algorithm(vector<Flow> &flows, vector<Port> &ports, vector<Result> &res) {
 	if (res.size() < flows.size()) {
-		cout << "有流缺失，或数据输出格式有误" << endl;
+		*errorstream() << "有流缺失，或数据输出格式有误" << endl;
 		return 0;
 	}
 	for (const auto &iter: res) {
 		int t = iter.sendtime;
 
 		if (iter.flowid >= flows.size() || iter.flowid < 0) {
-			cout << "流id不存在，错误结果为" << iter.flowid << ',' << iter.portid << ',' << t << endl;
+			*errorstream() << "流id不存在，错误结果为" << iter.flowid << ',' << iter.portid << ',' << t << endl;
 			return 0;
 		}
 		if (iter.portid >= ports.size() || iter.portid < 0) {
-			cout << "端口id不存在，错误结果为" << iter.flowid << ',' << iter.portid << ',' << t << endl;
+			*errorstream() << "端口id不存在，错误结果为" << iter.flowid << ',' << iter.portid << ',' << t << endl;
 			return 0;
 		}
 
 		Flow &flow = flows[iter.flowid];
 		Port &port = ports[iter.portid];
 		if (t < flow.begintime) {
-			cout << "流发送时间小于进入设备时间，错误结果为" << iter.flowid << ',' << iter.portid << ',' << t << endl;
+			*errorstream() << "流发送时间小于进入设备时间，错误结果为" << iter.flowid << ',' << iter.portid << ',' << t << endl;
 			return 0;
 		}
 		if (flow.speed > port.maxspeed) {
-			cout << "流带宽大于端口最大带宽，错误结果为" << iter.flowid << ',' << iter.portid << ',' << t << endl;
+			*errorstream() << "流带宽大于端口最大带宽，错误结果为" << iter.flowid << ',' << iter.portid << ',' << t << endl;
 			return 0;
 		}
 		if (flow.issend) {
-			cout << "流被重复发送，错误结果为" << iter.flowid << ',' << iter.portid << ',' << t << endl;
+			*errorstream() << "流被重复发送，错误结果为" << iter.flowid << ',' << iter.portid << ',' << t << endl;
 			return 0;
 		}
 		flow.sendtime = t;
@@ -223,24 +223,103 @@ int algorithm(vector<Flow> &flows, vector<Port> &ports, vector<Result> &res) {
 	}
 	for (const auto &flow: flows) {
 		if (!flow.issend) {
-			cout << "有流未被发送，未发送的流编号为" << flow.id << endl;
+			*errorstream() << "有流未被发送，未发送的流编号为" << flow.id << endl;
 			return 0;
 		}
 	}
 	return updateport(ports);
 }
+/*总时间的下界，见common/lower_bound.h，这里没有排队区上限和罚时*/
 double best(vector<Flow> &flows, vector<Port> &ports) {
-	long long int needspeed = 0;
-	long long int cansendspeed = 0;
-	for (int i = 0; i < flows.size(); ++i) {
-		needspeed += (long long int) flows[i].speed * flows[i].needtime;
+	vector<BoundFlow> shapes;
+	vector<int> maxspeeds;
+	for (const auto &flow: flows)
+		shapes.push_back({flow.speed, flow.begintime, flow.needtime});
+	for (const auto &port: ports)
+		maxspeeds.push_back(port.maxspeed);
+	return lowerBoundWith(shapes, maxspeeds, NoQueueRules()).value();
+}
+/*从solve1 --shm NAME写入的共享内存环形缓冲区/NAME.N读取全部结果*/
+bool shminput(const string &name, int No, vector<Result> &results, int timeoutMs) {
+	ResultRing *ring = ResultRing::open(name, No, timeoutMs);
+	if (ring == nullptr) {
+		cout << "共享内存结果通道打开失败" << endl;
+		return false;
 	}
-	for (int i = 0; i < ports.size(); ++i) {
-		cansendspeed += ports[i].maxspeed;
+	ResultRing::Record r{};
+	while (ring->pop(r))
+		results.emplace_back(r.flowid, r.portid, r.sendtime);
+	delete ring;
+	return true;
+}
+
+/*并行评分：root下的所有数据集放进线程池同时评分，输出csv表格，总分数的计算方式与串行相同*/
+int parallelscore(const string &root, int jobs) {
+	int num = 0;
+	while (true) {
+		ifstream f(root + "/" + to_string(num) + "/flow.txt");
+		if (!f.is_open())
+			break;
+		++num;
+	}
+	vector<int> times(num, 0);
+	vector<double> bests(num, 0);
+	vector<char> ok(num, 0);
+	vector<string> errors(num);
+	atomic<int> next(0);
+	auto worker = [&]() {
+		int No;
+		while ((No = next++) < num) {
+			vector<Flow> flows;
+			vector<Port> ports;
+			vector<Result> res;
+			//出错信息先收集起来，最后输出到标准错误，不混进标准输出的表格
+			ostringstream out;
+			errorstream() = &out;
+			if (Input(root + "/" + to_string(No), flows, ports, res)) {
+				stable_sort(res.begin(), res.end(),
+				            [](const Result &x, const Result &y) { return x.sendtime < y.sendtime; });
+				times[No] = algorithm(flows, ports, res);
+				bests[No] = best(flows, ports);
+				ok[No] = 1;
+			}
+			errorstream() = &cout;
+			errors[No] = out.str();
+		}
+	};
+	vector<thread> pool;
+	for (int i = 1; i < jobs; ++i)
+		pool.emplace_back(worker);
+	worker();
+	for (auto &t: pool)
+		t.join();
+
+	for (int i = 0; i < num; ++i) {
+		if (!errors[i].empty())
+			fprintf(stderr, "第%d号文件：%s", i, errors[i].c_str());
+	}
+	//和串行一样，遇到第一个读取失败的数据集就停止计分
+	int No = 0;
+	long long alltime = 0;
+	double allbest = 0;
+	double score = 0;
+	double bestscore = 0;
+	printf("dataset,time,best,score,best_score,gap\n");
+	for (; No < num && ok[No]; ++No) {
+		double thisscore = 100 / (log(times[No]) / log(10));
+		double thisbestscore = 100 / (log(bests[No]) / log(10));
+		printf("%d,%d,%.10g,%.10g,%.10g,%.6f\n", No, times[No], bests[No], thisscore, thisbestscore,
+		       boundGap(times[No], bests[No]));
+		alltime += times[No];
+		allbest += bests[No];
+		score += thisscore;
+		bestscore += thisbestscore;
 	}
-	return needspeed / double(cansendspeed);
+	printf("total,%lld,%.10g,%.10g,%.10g,%.6f\n", alltime, allbest, score / No, bestscore / No,
+	       boundGap((double) alltime, allbest));
+	return 0;
 }
-int main() {
+int main(int argc, char *argv[]) {
 	int No = 0;
 	vector<Flow> flows;
 	vector<Port> ports;
@@ -250,9 +329,36 @@ int main() {
 	double score = 0;
 	double bestscore = 0;
 	string path;
+	string root = "../data";
+	//--parallel [--jobs N] [--root 数据根目录] ：所有数据集并行评分，输出csv表格
+	bool parallel = false;
+	int jobs = (int) thread::hardware_concurrency();
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--parallel") == 0) {
+			parallel = true;
+		} else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+			jobs = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
+			root = argv[++i];
+		}
+	}
+	if (parallel)
+		return parallelscore(root, max(jobs, 1));
+	//--shm NAME [--shm-timeout 秒数] ：结果不读文件，从solve1 --shm NAME写入的共享内存环形缓冲区/NAME.N中读取
+	//默认一直等solve1创建共享内存段，给出--shm-timeout时超时后停止
+	string shmname;
+	int shmtimeout = -1;
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (strcmp(argv[i], "--shm") == 0)
+			shmname = argv[i + 1];
+		else if (strcmp(argv[i], "--shm-timeout") == 0)
+			shmtimeout = (int) min(atof(argv[i + 1]) * 1000, (double) INT_MAX);
+	}
 	while (true) {
-		path = "../data/" + to_string(No);
-		if (!Input(path, flows, ports, res))
+		path = root + "/" + to_string(No);
+		if (!Input(path, flows, ports, res, shmname.empty()))
+			break;
+		if (!shmname.empty() && !shminput(shmname, No, res, shmtimeout))
 			break;
 		stable_sort(res.begin(), res.end(), [](const Result &x, const Result &y) { return x.sendtime < y.sendtime; });
 		int thistime = algorithm(flows, ports, res);
@@ -264,6 +370,8 @@ int main() {
 		cout << "实际结果：" << thistime << endl;
 		cout << "分数：" << 100 / (log(thistime) / log(10)) << endl;
 		cout << "理论最高分数：" << 100 / (log(thisbest) / log(10)) << endl;
+		if (thistime > 0)
+			cout << "与下界差距：" << boundGap(thistime, thisbest) * 100 << "%" << endl;
 		cout << endl;
 		score += 100 / (log(thistime) / log(10));
 		bestscore += 100 / (log(thisbest) / log(10));
@@ -0,0 +1,573 @@
+#ifndef ZET_2023_CHECKER_H
+#define ZET_2023_CHECKER_H
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <map>
+#include <deque>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <cstdint>
+#include <thread>
+#include "../common/rules.h"
+#include "../common/lower_bound.h"
+#include "../common/latency.h"
+
+/*determine_2的检查核心，单独放在头文件里供determine_2和常驻调度服务共用*/
+namespace checker {
+
+/*检查器的出错信息写到这里，默认为标准输出；线程局部，多线程评分时每个线程可以换成自己的ostringstream*/
+inline std::ostream *&errorstream() {
+	thread_local std::ostream *out = &std::cout;
+	return out;
+}
+
+class Flow {
+public:
+	int id;
+	int speed;
+	int begintime;
+	int sendtime;
+	int needtime;
+	bool issend;
+	Flow(int i = -1, int s = 0, int b = 0, int n = 0);
+};
+
+class Port {
+public:
+	int id;
+	int speed;
+	int maxspeed;
+	std::multimap<int, Flow> flowqueue;
+	Port(int i, int s);
+};
+
+class Result {
+public:
+	int flowid;
+	int portid;
+	int sendtime;
+	Result(int f, int p, int s);
+};
+
+inline Flow::Flow(int i, int s, int b, int n) {
+	id = i;
+	speed = s;
+	begintime = b;
+	needtime = n;
+	issend = false;
+	sendtime = -1;
+}
+inline Port::Port(int i, int s) {
+	id = i;
+	speed = s;
+	maxspeed = speed;
+}
+inline Result::Result(int f, int p, int s) {
+	flowid = f;
+	portid = p;
+	sendtime = s;
+}
+
+/*负责数据的输入部分，将两个文件里的数据读入处理*/
+inline bool Input(std::string path, std::vector<Flow> &flows, std::vector<Port> &ports, std::vector<Result> &results,
+                  int &maxcachesize, bool readresult = true) {
+	std::ifstream input;
+	int allspeed = 0;
+	int alltime = 0;
+	int allportspeed = 0;
+	int flowcount = 0;
+	int portcount = 0;
+	std::string path1 = path + "/flow.txt";
+	std::string path2 = path + "/port.txt";
+	std::string path3 = path + "/result.txt";
+	input.open(path1, std::ios::in);
+	if (!input.is_open())
+		return false;
+	input.ignore(100, '\n');
+	/*输入flow*/
+	while (!input.eof()) {
+		Flow flow(-1, 0, 0, 0);
+		char t;
+		input >> flow.id >> t >> flow.speed >> t >> flow.begintime >> t >> flow.needtime;
+		if (flow.id == -1)
+			break;
+		allspeed += flow.speed;
+		alltime += flow.needtime;
+		++flowcount;
+		flows.push_back(flow);
+	}
+	input.close();
+	/*flow输入完毕*/
+	input.open(path2, std::ios::in);
+	if (!input.is_open())
+		return false;
+	input.ignore(100, '\n');
+	/*输入port*/
+	while (!input.eof()) {
+		Port port(-1, 0);
+		char t;
+		input >> port.id >> t >> port.maxspeed;
+		port.speed = port.maxspeed;
+		if (port.id == -1)
+			break;
+		allportspeed += port.speed;
+		++portcount;
+		ports.push_back(port);
+	}
+	input.close();
+	//cout << "流带宽总和    ：" << allspeed << endl;
+	//cout << "流占用时间总和：" << alltime << endl;
+	//cout << "端口带宽总和  ：" << allportspeed << endl;
+	//cout << "流数量        ：" << flowcount << endl;
+	//cout << "端口数量      ：" << portcount << endl;
+	//cout << "流带宽平均值  ：" << allspeed / double(flowcount) << endl;
+	//cout << "端口带宽平均值：" << allportspeed / double(portcount) << endl;
+	//cout << "流占用时间平均值：" << alltime / double(flowcount) << endl;
+	//cout << endl;
+	/*port输入完毕*/
+	if (readresult) {
+		input.open(path3, std::ios::in);
+		if (!input.is_open()) {
+			*errorstream() << "找不到结果文件" << std::endl;
+			return false;
+		}
+
+		while (!input.eof()) {
+			Result res(-1, -1, -1);
+			char t;
+			input >> res.flowid >> t >> res.portid >> t >> res.sendtime;
+			if (res.sendtime == -1)
+				break;
+			results.push_back(res);
+		}
+	}
+	maxcachesize = ports.size() * StandardRules::bufferFactor;
+	std::sort(flows.begin(), flows.end(), [](const Flow &x, const Flow &y) { return x.begintime < y.begintime; });
+	return true;
+}
+/*增量检查器：结果按发送时间非递减的顺序逐条输入，边输入边模拟，不需要保存全部结果
+ *规则R见common/rules.h，排队区上限、罚时和缓存区上限都是编译期常数，排队区为定长环形缓冲区
+ *每条结果输入时先把该端口更新到当前时刻，再决定直接发送、进入排队区还是被丢弃：
+ *排队区非空时队首放不下，新来的流一定排在队尾等待，若排队区已满它就是时刻结束时被清除的那一个，
+ *所以结果与"整个时刻的结果都入队后再更新端口、清除溢出"相同，排队区不会超过上限*/
+template<class R>
+class BasicChecker {
+public:
+	BasicChecker(std::vector<Flow> &f, std::vector<Port> &p, const R &rules = R());
+	bool push(const Result &r);//输入一条结果，出错返回false
+	bool pushchecked(const Result &r);//输入一条已通过validate的结果，只检查缓存区，不再逐项检查
+	size_t validate(const std::vector<Result> &res, int threads) const;//并行预检查，返回第一条不合法结果的下标，全部合法时为res.size()
+	bool dropped() const;//最后输入的一条结果是否因排队区已满被丢弃
+	int overflow() const;//到目前为止丢弃的罚时之和，finish返回的总时间中除去它就是最后一个流发送完毕的时刻
+	int finish();//输入结束，把排队区发送完并返回总时间，出错返回0
+	void track(LatencyTracker *tracker);//记录每个流的延迟（见common/latency.h），流的下标为flows中的下标，为空时不记录
+private:
+	std::vector<Flow> &flows;
+	std::vector<Port> &ports;
+	R rules;
+	int maxcachesize;
+	std::vector<int> flowid;
+	PortQueues<R> waitqueues;//所有端口的排队区，存放流在flows中的下标
+	std::vector<int> lastupdate;//端口最后一次释放已发送完毕的流的时刻
+	int time;
+	int overflowtime;
+	int lastsendtime;
+	int arrived;//begintime小于等于当前时间的流数量（flows按begintime升序）
+	int sent;//已发送的流数量
+	bool failed;
+	bool lastdropped;
+	LatencyTracker *latency;
+	void updateport(int i);//把端口i更新到当前时刻
+	bool tick();//结束当前时刻：更新端口、检查缓存区
+	bool pushresult(const Result &r, bool check);
+};
+
+template<class R>
+inline BasicChecker<R>::BasicChecker(std::vector<Flow> &f, std::vector<Port> &p, const R &r)
+		: flows(f), ports(p), rules(r), flowid(f.size()), waitqueues(p.size()), lastupdate(p.size(), -1) {
+	maxcachesize = rules.bufferFactor * (int) ports.size();
+	for (int i = 0; i < (int) flows.size(); ++i) {
+		flowid[flows[i].id] = i;
+	}
+	time = 0;
+	overflowtime = 0;
+	lastsendtime = INT_MIN;
+	arrived = 0;
+	sent = 0;
+	failed = false;
+	lastdropped = false;
+	latency = nullptr;
+}
+
+template<class R>
+inline void BasicChecker<R>::updateport(int i) {
+	Port &port = ports[i];
+	if (lastupdate[i] != time)//每个时刻只释放一次，本时刻开始发送的流最早下一时刻才释放
+	{
+		lastupdate[i] = time;
+		for (auto j = port.flowqueue.begin(); j != port.flowqueue.end();)//对端口中已发送的流检查是否发送完毕
+		{
+			if (j->first > time)//map为升序 所以最小值大于当前时间就代表没有发送完毕的流了
+			{
+				break;
+			} else//反之还有发送完毕的流 把它占用的端口腾出来
+			{
+				port.speed += j->second.speed;//将端口带宽还原回去
+				port.flowqueue.erase(j);//在在缓冲区中删除
+				j = port.flowqueue.begin();
+			}
+		}
+	}
+	while (!waitqueues.empty(i) && flows[waitqueues.front(i)].sendtime <= time)//对每个端口中等待队列发送时间小于等于当前时间的流检测一遍是否能发送
+	{
+		const Flow &flow = flows[waitqueues.front(i)];
+		if (flow.speed <= port.speed)//端口剩余空间足够，可以发送
+		{
+			port.flowqueue.insert(std::pair<int, Flow>(time + flow.needtime, flow));//将这个流放入已发送队列
+			port.speed -= flow.speed;//将端口可用空间减去流需要占用的空间
+			if (latency != nullptr)
+				latency->start(waitqueues.front(i), flow.speed, flow.begintime, time, flow.needtime);
+			waitqueues.pop(i);//出等待队列
+		} else {
+			break;
+		}
+	}
+}
+
+template<class R>
+inline bool BasicChecker<R>::tick() {
+	for (int i = 0; i < (int) ports.size(); ++i)
+		updateport(i);
+	while (arrived < (int) flows.size() && flows[arrived].begintime <= time)
+		++arrived;
+	//已发送的流一定满足begintime<=sendtime<=time，所以调度区中的流数量就是arrived-sent
+	if (R::queueing && arrived - sent > maxcachesize) {
+		*errorstream() << "流调度区爆了！" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+template<class R>
+inline bool BasicChecker<R>::pushresult(const Result &r, bool check) {
+	if (failed)
+		return false;
+	failed = true;
+	lastdropped = false;
+	int t = r.sendtime;
+	if (check && t < lastsendtime) {
+		*errorstream() << "结果未按发送时间排序，错误结果为" << r.flowid << ',' << r.portid << ',' << t << std::endl;
+		return false;
+	}
+	while (t > time)//当前时刻的结果已经全部输入
+	{
+		if (!tick())
+			return false;
+		++time;
+	}
+	if (check && (r.flowid >= (int) flows.size() || r.flowid < 0)) {
+		*errorstream() << "流id不存在，错误结果为" << r.flowid << ',' << r.portid << ',' << t << std::endl;
+		return false;
+	}
+	if (check && (r.portid >= (int) ports.size() || r.portid < 0)) {
+		*errorstream() << "端口id不存在，错误结果为" << r.flowid << ',' << r.portid << ',' << t << std::endl;
+		return false;
+	}
+
+	int index = flowid[r.flowid];
+	Flow &flow = flows[index];
+	Port &port = ports[r.portid];
+	if (check && t < flow.begintime) {
+		*errorstream() << "流发送时间小于进入设备时间，错误结果为" << r.flowid << ',' << r.portid << ',' << t << std::endl;
+		return false;
+	}
+	if (check && flow.speed > port.maxspeed) {
+		*errorstream() << "流带宽大于端口最大带宽，错误结果为" << r.flowid << ',' << r.portid << ',' << t << std::endl;
+		return false;
+	}
+	if (check && flow.issend) {
+		*errorstream() << "流被重复发送，错误结果为" << r.flowid << ',' << r.portid << ',' << t << std::endl;
+		return false;
+	}
+	flow.sendtime = t;
+	flow.issend = true;
+	updateport(r.portid);
+	if (latency != nullptr)
+		latency->leave(index, r.portid, flow.begintime, t);
+	if (waitqueues.empty(r.portid) && flow.speed <= port.speed)//排队区为空且端口放得下，直接发送
+	{
+		port.flowqueue.insert(std::pair<int, Flow>(t + flow.needtime, flow));
+		port.speed -= flow.speed;
+		if (latency != nullptr)
+			latency->start(index, flow.speed, flow.begintime, t, flow.needtime);
+	} else if (R::queueing && waitqueues.size(r.portid) >= rules.queueLimit)//排队区已满，丢弃并计算加权时间
+	{
+		overflowtime += rules.penalty * flow.needtime;
+		lastdropped = true;
+		if (latency != nullptr)
+			latency->drop(index, flow.speed);
+	} else {
+		waitqueues.push(r.portid, index);
+	}
+	++sent;
+	lastsendtime = t;
+	failed = false;
+	return true;
+}
+
+template<class R>
+inline bool BasicChecker<R>::push(const Result &r) {
+	return pushresult(r, true);
+}
+
+template<class R>
+inline bool BasicChecker<R>::pushchecked(const Result &r) {
+	return pushresult(r, false);
+}
+
+/*逐项检查与模拟无关，分成threads段并行进行，每段找出自己的第一条不合法结果
+ *重复发送用位图判断，每段一个按流id的位图，段内位已经是1的流记为可能重复，各段位图两两有交集的流也记为可能重复；
+ *不用所有段共享的原子位图：原子的fetch_or让各条结果的随机访存不能重叠，1000万条结果上检查慢约40%
+ *只在有可能重复的流时再顺序扫描一遍，找出真正的第二次发送
+ *只检查从头开始、且检查器尚未输入任何结果时的res，之前的结果交给pushchecked，第一条不合法的结果交给push，
+ *这样缓存区爆掉和不合法结果谁先出现、输出的错误信息都与逐条push完全相同*/
+template<class R>
+inline size_t BasicChecker<R>::validate(const std::vector<Result> &res, int threads) const {
+	size_t n = res.size();
+	size_t words = (flows.size() + 63) / 64;
+	threads = std::max(1, std::min(threads, (int) (n / 65536) + 1));//每段至少约6.5万条，太短时线程开销比检查还大
+	std::vector<std::vector<uint64_t>> seen(threads);
+	std::vector<size_t> first(threads, n);
+	std::vector<std::vector<int>> repeated(threads);
+	std::vector<int> maxspeeds;
+	for (const auto &port: ports)
+		maxspeeds.push_back(port.maxspeed);
+	auto run = [&](int k) {
+		size_t lo = n * k / threads;
+		size_t hi = n * (k + 1) / threads;
+		seen[k].assign(words, 0);
+		uint64_t *bits = seen[k].data();
+		int prevtime = lo > 0 ? res[lo - 1].sendtime : INT_MIN;
+		const Result *rs = res.data();
+		const Flow *fs = flows.data();
+		const int *index = flowid.data();
+		unsigned flownum = flows.size();
+		unsigned portnum = ports.size();
+		for (size_t i = lo; i < hi; ++i) {
+			const Result &r = rs[i];
+			if (r.sendtime < prevtime || (unsigned) r.flowid >= flownum || (unsigned) r.portid >= portnum) {
+				first[k] = i;
+				return;
+			}
+			const Flow &flow = fs[index[r.flowid]];
+			if (r.sendtime < flow.begintime || flow.speed > maxspeeds[r.portid]) {
+				first[k] = i;
+				return;
+			}
+			prevtime = r.sendtime;
+			uint64_t bit = uint64_t(1) << (r.flowid & 63);
+			if (bits[r.flowid >> 6] & bit)
+				repeated[k].push_back(r.flowid);
+			bits[r.flowid >> 6] |= bit;
+		}
+	};
+	std::vector<std::thread> pool;
+	for (int k = 1; k < threads; ++k)
+		pool.emplace_back(run, k);
+	run(0);
+	for (auto &t: pool)
+		t.join();
+	size_t bad = *std::min_element(first.begin(), first.end());
+	std::vector<char> suspect;
+	auto mark = [&](int id) {
+		if (suspect.empty())
+			suspect.assign(flows.size(), 0);
+		suspect[id] = 1;
+	};
+	for (const auto &list: repeated) {
+		for (int id: list)
+			mark(id);
+	}
+	for (int k = 1; k < threads; ++k)//与前面各段都出现过的流
+	{
+		for (size_t w = 0; w < words; ++w) {
+			uint64_t both = seen[k][w] & seen[0][w];
+			seen[0][w] |= seen[k][w];
+			for (; both != 0; both &= both - 1)
+				mark((int) (64 * w + __builtin_ctzll(both)));
+		}
+	}
+	if (suspect.empty())
+		return bad;
+	for (size_t i = 0; i < bad; ++i)//可能重复的流第二次出现的位置
+	{
+		int id = res[i].flowid;
+		if (suspect[id] == 2)
+			return i;
+		if (suspect[id] == 1)
+			suspect[id] = 2;
+	}
+	return bad;
+}
+
+template<class R>
+inline bool BasicChecker<R>::dropped() const {
+	return lastdropped;
+}
+
+template<class R>
+inline void BasicChecker<R>::track(LatencyTracker *tracker) {
+	latency = tracker;
+}
+
+template<class R>
+inline int BasicChecker<R>::overflow() const {
+	return overflowtime;
+}
+
+template<class R>
+inline int BasicChecker<R>::finish() {
+	if (failed || !tick())
+		return 0;
+	failed = true;
+	while (true)//把排队区的所有流都发送出去
+	{
+		int count = 0;
+		for (int i = 0; i < (int) ports.size(); ++i) {
+			if (waitqueues.empty(i))
+				++count;
+		}
+		if (count == (int) ports.size())
+			break;
+		++time;
+		for (int i = 0; i < (int) ports.size(); ++i)
+			updateport(i);
+	}
+
+
+	for (const auto &flow: flows) {
+		if (!flow.issend) {
+			*errorstream() << "有流未被发送，未发送的流编号为" << flow.id << std::endl;
+			return 0;
+		}
+	}
+	int maxtime = time;
+
+	for (auto &port: ports)//遍历所有端口已发送的队列，找到最晚发送完毕的时间并返回
+	{
+		if (port.flowqueue.empty())
+			continue;
+		else {
+			auto last = port.flowqueue.end();
+			--last;
+			maxtime = std::max(maxtime, last->first);
+		}
+	}
+
+	maxtime += overflowtime;
+	return maxtime;
+}
+
+//比赛规则下的检查器
+using Checker = BasicChecker<StandardRules>;
+
+/*数据处理，rules为比赛规则时使用编译期常数的检查器
+ *逐项检查先用threads个线程并行预检查（见validate），之后只有排队区和缓存区的模拟是串行的
+ *latency不为空时同时记录每个流的延迟*/
+inline int algorithm(std::vector<Flow> &flows, std::vector<Port> &ports, std::vector<Result> &res,
+                     const RuleSet &rules = RuleSet(), int threads = 1, LatencyTracker *latency = nullptr) {
+
+	if (res.size() < flows.size()) {
+		*errorstream() << "有流缺失，或数据输出格式有误" << std::endl;
+		return 0;
+	}
+	return withRules(rules, [&](const auto &r) {
+		BasicChecker<std::decay_t<decltype(r)>> checker(flows, ports, r);
+		checker.track(latency);
+		//只有一个线程时预检查只会多一遍随机访存，直接逐条push
+		bool checked = threads > 1;
+		size_t bad = checked ? checker.validate(res, threads) : res.size();
+		for (size_t i = 0; i < bad; ++i) {
+			if (!(checked ? checker.pushchecked(res[i]) : checker.push(res[i])))
+				return 0;
+		}
+		if (bad < res.size()) {
+			checker.push(res[bad]);//输出错误信息
+			return 0;
+		}
+		return checker.finish();
+	});
+}
+
+/*从输入流中逐条读取结果交给检查器，不保存结果
+ *文本格式与result.txt相同；二进制格式以"ZRS1"开头，后面每条结果为3个int32（flowid,portid,sendtime）*/
+inline int streamalgorithm(FILE *in, std::vector<Flow> &flows, std::vector<Port> &ports) {
+	Checker checker(flows, ports);
+	char buf[1 << 16];
+	size_t len = fread(buf, 1, 4, in);
+	if (len == 4 && memcmp(buf, "ZRS1", 4) == 0) {
+		int rec[3 * 4096];
+		size_t n;
+		while ((n = fread(rec, sizeof(int) * 3, 4096, in)) > 0) {
+			for (size_t i = 0; i < n; ++i) {
+				if (!checker.push(Result(rec[3 * i], rec[3 * i + 1], rec[3 * i + 2])))
+					return 0;
+			}
+		}
+		return checker.finish();
+	}
+	int value[3];
+	int field = 0;
+	int sign = 1;
+	int number = 0;
+	bool indigit = false;
+	do {
+		for (size_t i = 0; i < len; ++i) {
+			char c = buf[i];
+			if (c >= '0' && c <= '9') {
+				number = number * 10 + (c - '0');
+				indigit = true;
+			} else if (c == '-' && !indigit) {
+				sign = -1;
+			} else if (indigit) {
+				value[field++] = sign * number;
+				number = 0;
+				sign = 1;
+				indigit = false;
+				if (field == 3) {
+					field = 0;
+					if (!checker.push(Result(value[0], value[1], value[2])))
+						return 0;
+				}
+			}
+		}
+	} while ((len = fread(buf, 1, sizeof(buf), in)) > 0);
+	if (indigit) {
+		value[field++] = sign * number;
+		if (field == 3 && !checker.push(Result(value[0], value[1], value[2])))
+			return 0;
+	}
+	return checker.finish();
+}
+/*总时间的下界，见common/lower_bound.h*/
+inline LowerBound bounds(const std::vector<Flow> &flows, const std::vector<Port> &ports) {
+	std::vector<BoundFlow> shapes;
+	std::vector<int> maxspeeds;
+	for (const Flow &flow: flows)
+		shapes.push_back({flow.speed, flow.begintime, flow.needtime});
+	for (const Port &port: ports)
+		maxspeeds.push_back(port.maxspeed);
+	return lowerBoundWith(shapes, maxspeeds, StandardRules());
+}
+inline double best(std::vector<Flow> &flows, std::vector<Port> &ports) {
+	return bounds(flows, ports).value();
+}
+
+}
+
+#endif //ZET_2023_CHECKER_H
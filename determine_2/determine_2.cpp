@@ -7,302 +7,218 @@
 #include <deque>
 #include <iomanip>
 #include <cmath>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include "checker.h"
+#include "incremental.h"
+#include "../common/result_ring.h"
 
 using namespace std;
+using namespace checker;
 
-class Flow {
-public:
-	int id;
-	int speed;
-	int begintime;
-	int sendtime;
-	int needtime;
-	bool issend;
-	Flow(int i, int s, int b, int n);
-};
-
-class Port {
-public:
-	int id;
-	int speed;
-	int maxspeed;
-	multimap<int, Flow> flowqueue;
-	deque<Flow> waitqueue;
-	Port(int i, int s);
-};
-
-class Result {
-public:
-	int flowid;
-	int portid;
-	int sendtime;
-	Result(int f, int p, int s);
-};
-
-Flow::Flow(int i, int s, int b, int n) {
-	id = i;
-	speed = s;
-	begintime = b;
-	needtime = n;
-	issend = false;
-	sendtime = -1;
-}
-Port::Port(int i, int s) {
-	id = i;
-	speed = s;
-	maxspeed = speed;
-}
-Result::Result(int f, int p, int s) {
-	flowid = f;
-	portid = p;
-	sendtime = s;
-}
-
-/*负责数据的输入部分，将两个文件里的数据读入处理*/
-bool Input(string path, vector<Flow> &flows, vector<Port> &ports, vector<Result> &results, int &maxcachesize) {
-	ifstream input;
-	int allspeed = 0;
-	int alltime = 0;
-	int allportspeed = 0;
-	int flowcount = 0;
-	int portcount = 0;
-	string path1 = path + "/flow.txt";
-	string path2 = path + "/port.txt";
-	string path3 = path + "/result.txt";
-	input.open(path1, ios::in);
-	if (!input.is_open())
-		return false;
-	input.ignore(100, '\n');
-	/*输入flow*/
-	while (!input.eof()) {
-		Flow flow(-1, 0, 0, 0);
-		char t;
-		input >> flow.id >> t >> flow.speed >> t >> flow.begintime >> t >> flow.needtime;
-		if (flow.id == -1)
-			break;
-		allspeed += flow.speed;
-		alltime += flow.needtime;
-		++flowcount;
-		flows.push_back(flow);
-	}
-	input.close();
-	/*flow输入完毕*/
-	input.open(path2, ios::in);
-	if (!input.is_open())
-		return false;
-	input.ignore(100, '\n');
-	/*输入port*/
-	while (!input.eof()) {
-		Port port(-1, 0);
-		char t;
-		input >> port.id >> t >> port.maxspeed;
-		port.speed = port.maxspeed;
-		if (port.id == -1)
-			break;
-		allportspeed += port.speed;
-		++portcount;
-		ports.push_back(port);
-	}
-	input.close();
-	//cout << "流带宽总和    ：" << allspeed << endl;
-	//cout << "流占用时间总和：" << alltime << endl;
-	//cout << "端口带宽总和  ：" << allportspeed << endl;
-	//cout << "流数量        ：" << flowcount << endl;
-	//cout << "端口数量      ：" << portcount << endl;
-	//cout << "流带宽平均值  ：" << allspeed / double(flowcount) << endl;
-	//cout << "端口带宽平均值：" << allportspeed / double(portcount) << endl;
-	//cout << "流占用时间平均值：" << alltime / double(flowcount) << endl;
-	//cout << endl;
-	/*port输入完毕*/
-	input.open(path3, ios::in);
-	if (!input.is_open()) {
-		cout << "找不到结果文件" << endl;
-		return false;
-	}
-
-	while (!input.eof()) {
-		Result res(-1, -1, -1);
-		char t;
-		input >> res.flowid >> t >> res.portid >> t >> res.sendtime;
-		if (res.sendtime == -1)
-			break;
-		results.push_back(res);
+/*从共享内存环形缓冲区逐条读取结果交给检查器，结果必须按发送时间非递减（solve2的输出顺序）*/
+int shmalgorithm(const string &name, int No, vector<Flow> &flows, vector<Port> &ports, int timeoutMs) {
+	ResultRing *ring = ResultRing::open(name, No, timeoutMs);
+	if (ring == nullptr) {
+		cout << "共享内存结果通道打开失败" << endl;
+		return 0;
 	}
-	maxcachesize = ports.size() * 20;
-	sort(flows.begin(), flows.end(), [](const Flow &x, const Flow &y) { return x.begintime < y.begintime; });
-	return true;
+	Checker checker(flows, ports);
+	ResultRing::Record r{};
+	bool ok = true;
+	while (ok && ring->pop(r))
+		ok = checker.push(Result(r.flowid, r.portid, r.sendtime));
+	delete ring;
+	return ok ? checker.finish() : 0;
 }
-/*更新端口状态*/
-void updateport(vector<Port> &ports, const int &time) {
 
-	for (auto &port: ports)//对每个端口进行处理
-	{
-		for (auto j = port.flowqueue.begin(); j != port.flowqueue.end();)//对端口中已发送的流检查是否发送完毕
-		{
-			if (j->first > time)//map为升序 所以最小值大于当前时间就代表没有发送完毕的流了
-			{
-				break;
-			} else//反之还有发送完毕的流 把它占用的端口腾出来
-			{
-				port.speed += j->second.speed;//将端口带宽还原回去
-				port.flowqueue.erase(j);//在在缓冲区中删除
-				j = port.flowqueue.begin();
-			}
-		}
-		while (!port.waitqueue.empty() && port.waitqueue.front().sendtime <= time)//对每个端口中等待队列发送时间小于等于当前时间的流检测一遍是否能发送
-		{
-			if (port.waitqueue.front().speed <= port.speed)//端口剩余空间足够，可以发送
-			{
-				port.flowqueue.insert(
-						pair<int, Flow>(time + port.waitqueue.front().needtime, port.waitqueue.front()));//将这个流放入已发送队列
-				port.speed -= port.waitqueue.front().speed;//将端口可用空间减去流需要占用的空间
-				port.waitqueue.pop_front();//出等待队列
-			} else {
-				break;
-			}
-		}
+/*并行评分：root下的所有数据集放进线程池同时评分，输出csv表格，总分数的计算方式与串行相同*/
+int parallelscore(const string &root, int jobs) {
+	int num = 0;
+	while (true) {
+		ifstream f(root + "/" + to_string(num) + "/flow.txt");
+		if (!f.is_open())
+			break;
+		++num;
 	}
-
-	//int maxtime = time;
-
-	//return maxtime;
-}
-/*检查端口队列区情况，有溢出则清除溢出并计算加权时间*/
-int checkport(vector<Port> &ports) {
-	int overflowtime = 0;
-	for (auto &port: ports) {
-		if (port.waitqueue.size() <= 30)
-			continue;
-		else {
-			while (port.waitqueue.size() > 30) {
-				int i = port.waitqueue.size() - 1;
-				overflowtime += port.waitqueue[i].needtime;
-				port.waitqueue.erase(port.waitqueue.begin() + i);
+	vector<int> times(num, 0);
+	vector<double> bests(num, 0);
+	vector<char> ok(num, 0);
+	vector<string> errors(num);
+	atomic<int> next(0);
+	auto worker = [&]() {
+		int No;
+		while ((No = next++) < num) {
+			vector<Flow> flows;
+			vector<Port> ports;
+			vector<Result> res;
+			int maxcachesize = 0;
+			//检查器的出错信息先收集起来，最后输出到标准错误，不混进标准输出的表格
+			ostringstream out;
+			errorstream() = &out;
+			if (Input(root + "/" + to_string(No), flows, ports, res, maxcachesize)) {
+				stable_sort(res.begin(), res.end(),
+				            [](const Result &x, const Result &y) { return x.sendtime < y.sendtime; });
+				times[No] = algorithm(flows, ports, res);
+				bests[No] = best(flows, ports);
+				ok[No] = 1;
 			}
+			errorstream() = &cout;
+			errors[No] = out.str();
 		}
-	}
-	return overflowtime * 2;//2倍加权时间
-}
-/*数据处理*/
-int algorithm(vector<Flow> &flows, vector<Port> &ports, vector<Result> &res, int &maxcachesize) {
+	};
+	vector<thread> pool;
+	for (int i = 1; i < jobs; ++i)
+		pool.emplace_back(worker);
+	worker();
+	for (auto &t: pool)
+		t.join();
 
-	if (res.size() < flows.size()) {
-		cout << "有流缺失，或数据输出格式有误" << endl;
-		return 0;
+	for (int i = 0; i < num; ++i) {
+		if (!errors[i].empty())
+			fprintf(stderr, "第%d号文件：%s", i, errors[i].c_str());
 	}
-	vector<int> flowid(flows.size());
-	for (int i = 0; i < flows.size(); ++i) {
-		flowid[flows[i].id] = i;
+	//和串行一样，遇到第一个读取失败的数据集就停止计分
+	int No = 0;
+	long long alltime = 0;
+	double allbest = 0;
+	double score = 0;
+	double bestscore = 0;
+	printf("dataset,time,best,score,best_score,gap\n");
+	for (; No < num && ok[No]; ++No) {
+		double thisscore = 300 / (log(times[No]) / log(10));
+		double thisbestscore = 300 / (log(bests[No]) / log(10));
+		printf("%d,%d,%.10g,%.10g,%.10g,%.6f\n", No, times[No], bests[No], thisscore, thisbestscore,
+		       boundGap(times[No], bests[No]));
+		alltime += times[No];
+		allbest += bests[No];
+		score += thisscore;
+		bestscore += thisbestscore;
 	}
+	printf("total,%lld,%.10g,%.10g,%.10g,%.6f\n", alltime, allbest, score / No, bestscore / No,
+	       boundGap((double) alltime, allbest));
+	return 0;
+}
 
-	int time = 0;
-	int resultid = 0;
-	int overflowtime = 0;
+/*下界报告：root下的所有数据集放进线程池同时计算各种下界，输出csv表格，bound为其中最大的一个*/
+int boundreport(const string &root, int jobs) {
+	int num = 0;
 	while (true) {
-		for (; resultid < res.size(); ++resultid) {
-			int t = res[resultid].sendtime;
-			if (t > time)//当前结果还没到发送时间
-				break;
-			if (res[resultid].flowid >= flows.size() || res[resultid].flowid < 0) {
-				cout << "流id不存在，错误结果为" << res[resultid].flowid << ',' << res[resultid].portid << ',' << t
-				     << endl;
-				return 0;
-			}
-			if (res[resultid].portid >= ports.size() || res[resultid].portid < 0) {
-				cout << "端口id不存在，错误结果为" << res[resultid].flowid << ',' << res[resultid].portid << ',' << t
-				     << endl;
-				return 0;
-			}
-
-			Flow &flow = flows[flowid[res[resultid].flowid]];
-			Port &port = ports[res[resultid].portid];
-			if (t < flow.begintime) {
-				cout << "流发送时间小于进入设备时间，错误结果为" << res[resultid].flowid << ',' << res[resultid].portid
-				     << ',' << t << endl;
-				return 0;
-			}
-			if (flow.speed > port.maxspeed) {
-				cout << "流带宽大于端口最大带宽，错误结果为" << res[resultid].flowid << ',' << res[resultid].portid
-				     << ',' << t << endl;
-				return 0;
-			}
-			if (flow.issend) {
-				cout << "流被重复发送，错误结果为" << res[resultid].flowid << ',' << res[resultid].portid << ',' << t
-				     << endl;
-				return 0;
-			}
-			flow.sendtime = t;
-			port.waitqueue.push_back(flow);
-			flow.issend = true;
-		}
-
-
-		updateport(ports, time);
-		overflowtime += checkport(ports);
-		int count = 0;
-		for (const auto &flow: flows) {
-			if (flow.begintime > time)
-				break;
-			if (!flow.issend) {
-				++count;
-			}
-		}
-		if (count > maxcachesize) {
-			cout << "流调度区爆了！" << endl;
-			return 0;
-		}
-		if (resultid >= res.size())
+		ifstream f(root + "/" + to_string(num) + "/flow.txt");
+		if (!f.is_open())
 			break;
-		++time;
+		++num;
 	}
-	while (true)//把排队区的所有流都发送出去
-	{
-		int count = 0;
-		for (const auto &port: ports) {
-			if (port.waitqueue.empty())
-				++count;
+	vector<LowerBound> bounds(num);
+	vector<size_t> sizes(num, 0);
+	vector<double> seconds(num, 0);
+	vector<char> ok(num, 0);
+	atomic<int> next(0);
+	auto worker = [&]() {
+		int No;
+		while ((No = next++) < num) {
+			vector<Flow> flows;
+			vector<Port> ports;
+			vector<Result> res;
+			int maxcachesize = 0;
+			if (!Input(root + "/" + to_string(No), flows, ports, res, maxcachesize, false))
+				continue;
+			auto begin = chrono::steady_clock::now();
+			bounds[No] = checker::bounds(flows, ports);
+			seconds[No] = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+			sizes[No] = flows.size();
+			ok[No] = 1;
 		}
-		if (count == ports.size())
-			break;
-		++time;
-		updateport(ports, time);
+	};
+	vector<thread> pool;
+	for (int i = 1; i < jobs; ++i)
+		pool.emplace_back(worker);
+	worker();
+	for (auto &t: pool)
+		t.join();
+	printf("dataset,flows,energy,capacity,single,drops,bound,seconds\n");
+	for (int No = 0; No < num && ok[No]; ++No) {
+		const LowerBound &b = bounds[No];
+		printf("%d,%zu,%.10g,%.10g,%.10g,%.10g,%.10g,%.3f\n", No, sizes[No], b.energy, b.capacity, b.single, b.drops,
+		       b.value(), seconds[No]);
 	}
-
-
-	for (const auto &flow: flows) {
-		if (!flow.issend) {
-			cout << "有流未被发送，未发送的流编号为" << flow.id << endl;
-			return 0;
+	return 0;
+}
+/*增量检查基准：每个数据集随机做edits次单条结果修改（换一个放得下的端口或发送时间前后移动几个时刻），
+ *分别用增量检查器和algorithm()从头计分，比较分数和出错信息并统计平均耗时，分数变好的修改保留下来
+ *replayed为每次修改平均重新模拟的时刻数*/
+int editbench(const string &root, int edits) {
+	mt19937 rng(1);
+	printf("dataset,flows,edits,full_ms,incremental_ms,speedup,replayed,mismatch\n");
+	for (int No = 0;; ++No) {
+		vector<Flow> flows;
+		vector<Port> ports;
+		vector<Result> res;
+		int maxcachesize = 0;
+		if (!Input(root + "/" + to_string(No), flows, ports, res, maxcachesize))
+			break;
+		IncrementalChecker incremental(flows, ports, res);
+		vector<int> speed(flows.size());
+		vector<int> begintime(flows.size());
+		for (const Flow &flow: flows) {
+			speed[flow.id] = flow.speed;
+			begintime[flow.id] = flow.begintime;
 		}
-	}
-	int maxtime = time;
+		double fulltime = 0;
+		double incrementaltime = 0;
+		long long replayed = incremental.replayed();
+		int mismatch = 0;
+		for (int i = 0; i < edits; ++i) {
+			int index = (int) (rng() % res.size());
+			Result r = incremental.results()[index];
+			if (rng() % 2 == 0) {
+				int port = (int) (rng() % ports.size());
+				if (ports[port].maxspeed >= speed[r.flowid])
+					r.portid = port;
+			} else {
+				r.sendtime = max(begintime[r.flowid], r.sendtime + (int) (rng() % 7) - 3);
+			}
+			vector<Edit> edit = {{index, r.flowid, r.portid, r.sendtime}};
+			string message;
+			auto begin = chrono::steady_clock::now();
+			int time = incremental.evaluate(edit, &message);
+			incrementaltime += chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
 
-	for (auto &port: ports)//遍历所有端口已发送的队列，找到最晚发送完毕的时间并返回
-	{
-		if (port.flowqueue.empty())
-			continue;
-		else {
-			auto last = port.flowqueue.end();
-			--last;
-			maxtime = max(maxtime, last->first);
+			vector<Result> modified = incremental.results();
+			modified[index] = r;
+			stable_sort(modified.begin(), modified.end(),
+			            [](const Result &x, const Result &y) { return x.sendtime < y.sendtime; });
+			vector<Flow> f = flows;
+			vector<Port> p = ports;
+			ostringstream out;
+			streambuf *old = cout.rdbuf(out.rdbuf());
+			begin = chrono::steady_clock::now();
+			int expected = algorithm(f, p, modified);
+			fulltime += chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+			cout.rdbuf(old);
+			string printed = out.str();
+			if (!printed.empty() && printed.back() == '\n')
+				printed.pop_back();
+			if (time != expected || message != printed)
+				++mismatch;
+			if (time != 0 && time < incremental.score())
+				incremental.apply(edit);
 		}
+		replayed = incremental.replayed() - replayed;
+		printf("%d,%zu,%d,%.4f,%.4f,%.1f,%.1f,%d\n", No, flows.size(), edits, fulltime / edits,
+		       incrementaltime / edits, incrementaltime > 0 ? fulltime / incrementaltime : 0.0,
+		       (double) replayed / edits, mismatch);
 	}
-
-	maxtime += overflowtime;
-	return maxtime;
-}
-double best(vector<Flow> &flows, vector<Port> &ports) {
-	long long int needspeed = 0;
-	long long int cansendspeed = 0;
-	for (int i = 0; i < flows.size(); ++i) {
-		needspeed += (long long int) flows[i].speed * flows[i].needtime;
-	}
-	for (int i = 0; i < ports.size(); ++i) {
-		cansendspeed += ports[i].maxspeed;
-	}
-	return needspeed / double(cansendspeed);
+	return 0;
 }
-int main() {
+int main(int argc, char *argv[]) {
 	int No = 0;
 	vector<Flow> flows;
 	vector<Port> ports;
@@ -313,12 +229,77 @@ int main() {
 	double bestscore = 0;
 	int maxcachesize = 0;
 	string path;
+	//--stdin <数据目录> ：从标准输入读取按发送时间排好序的结果，例如 ./solve2 --stdout 0 | ./determine_2 --stdin ../data/0
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (strcmp(argv[i], "--stdin") == 0) {
+			path = argv[i + 1];
+			if (!Input(path, flows, ports, res, maxcachesize, false))
+				return 1;
+			int thistime = streamalgorithm(stdin, flows, ports);
+			double thisbest = best(flows, ports);
+			cout << path << "：" << endl;
+			cout << "理论最优：" << thisbest << endl;
+			cout << "实际结果：" << thistime << endl;
+			cout << "分数：" << 300 / (log(thistime) / log(10)) << endl;
+			cout << "理论最高分数：" << 300 / (log(thisbest) / log(10)) << endl;
+			if (thistime > 0)
+				cout << "与下界差距：" << boundGap(thistime, thisbest) * 100 << "%" << endl;
+			return 0;
+		}
+	}
+	string root = "../data";
+	//--parallel [--jobs N] [--root 数据根目录] ：所有数据集并行评分，输出csv表格
+	//--bounds [--jobs N] [--root 数据根目录] ：所有数据集并行计算下界，输出csv表格
+	//不带--parallel时--jobs N为每个数据集逐项检查的并行预检查线程数，见checker.h的validate
+	bool parallel = false;
+	bool boundsonly = false;
+	int jobs = (int) thread::hardware_concurrency();
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--parallel") == 0) {
+			parallel = true;
+		} else if (strcmp(argv[i], "--bounds") == 0) {
+			boundsonly = true;
+		} else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+			jobs = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
+			root = argv[++i];
+		}
+	}
+	if (parallel)
+		return parallelscore(root, max(jobs, 1));
+	if (boundsonly)
+		return boundreport(root, max(jobs, 1));
+	//--edits N [--root 数据根目录] ：增量检查基准，每个数据集随机做N次单条结果修改，对比增量检查器和从头计分
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (strcmp(argv[i], "--edits") == 0)
+			return editbench(root, max(atoi(argv[i + 1]), 1));
+	}
+	//--shm NAME [--shm-timeout 秒数] ：结果不读文件，从solve2 --shm NAME写入的共享内存环形缓冲区/NAME.N中逐条读取，边读边检查
+	//默认一直等solve2创建共享内存段（大数据集上solve2可能要算一分多钟），给出--shm-timeout时超时后该数据集记0分
+	string shmname;
+	int shmtimeout = -1;
+	//--latency ：按检查器的模拟记录每个流的缓存区等待、排队区等待和完成时间，分位数写入数据目录下的latency_check.csv，摘要输出到标准输出
+	bool withlatency = false;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc)
+			shmname = argv[i + 1];
+		else if (strcmp(argv[i], "--shm-timeout") == 0 && i + 1 < argc)
+			shmtimeout = (int) min(atof(argv[i + 1]) * 1000, (double) INT_MAX);
+		else if (strcmp(argv[i], "--latency") == 0)
+			withlatency = true;
+	}
 	while (true) {
-		path = "../data/" + to_string(No);
-		if (!Input(path, flows, ports, res, maxcachesize))
+		path = root + "/" + to_string(No);
+		if (!Input(path, flows, ports, res, maxcachesize, shmname.empty()))
 			break;
-		stable_sort(res.begin(), res.end(), [](const Result &x, const Result &y) { return x.sendtime < y.sendtime; });
-		int thistime = algorithm(flows, ports, res, maxcachesize);
+		int thistime;
+		LatencyTracker latency(withlatency ? (int) ports.size() : 0, withlatency ? flows.size() : 0);
+		if (!shmname.empty()) {
+			thistime = shmalgorithm(shmname, No, flows, ports, shmtimeout);
+		} else {
+			stable_sort(res.begin(), res.end(), [](const Result &x, const Result &y) { return x.sendtime < y.sendtime; });
+			thistime = algorithm(flows, ports, res, RuleSet(), max(jobs, 1), withlatency ? &latency : nullptr);
+		}
 		double thisbest = best(flows, ports);
 		alltime += thistime;
 		allbest += thisbest;
@@ -327,6 +308,17 @@ int main() {
 		cout << "实际结果：" << thistime << endl;
 		cout << "分数：" << 300 / (log(thistime) / log(10)) << endl;
 		cout << "理论最高分数：" << 300 / (log(thisbest) / log(10)) << endl;
+		if (thistime > 0)
+			cout << "与下界差距：" << boundGap(thistime, thisbest) * 100 << "%" << endl;
+		if (withlatency && shmname.empty() && thistime > 0) {
+			cout << "延迟：" << flush;
+			latency.summary(stdout);
+			FILE *out = fopen((path + "/latency_check.csv").c_str(), "w");
+			if (out != nullptr) {
+				latency.write(out);
+				fclose(out);
+			}
+		}
 		cout << endl;
 		score += 300 / (log(thistime) / log(10));
 		bestscore += 300 / (log(thisbest) / log(10));
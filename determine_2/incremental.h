@@ -0,0 +1,572 @@
+#ifndef ZET_2023_INCREMENTAL_H
+#define ZET_2023_INCREMENTAL_H
+
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <string>
+#include <vector>
+#include "checker.h"
+
+/*增量检查器：保存一份完整的结果和模拟过程中的检查点，对结果做少量修改后只从最早被修改的时刻重新模拟
+ *结果按(发送时间, 在结果中的序号)排序，与determine_2对结果文件stable_sort之后的顺序相同，
+ *每次修改后的分数和出错信息都与把修改后的结果排序后交给algorithm()相同*/
+namespace checker {
+
+/*把第index条结果（结果中的序号，不是排序后的位置）改为(flowid, portid, sendtime)*/
+struct Edit {
+	int index;
+	int flowid;
+	int portid;
+	int sendtime;
+};
+
+/*结果按发送时刻和端口分组，以时刻为单位模拟：
+ *同一时刻各端口互不影响，调度区只在时刻结束时检查，所以一个时刻内可以逐个端口处理；
+ *一个时刻里某个端口的排队区满了以后，这个时刻后面发到该端口的流都被丢弃，罚时用组内的前缀和一次算出，
+ *比赛数据里绝大多数结果都是这样被丢弃的，模拟的代价只和时刻数、端口数以及真正发送或排队的流数有关
+ *模拟是事件驱动的，只在有结果或有流发送完毕的时刻处理端口，与BasicChecker逐时刻模拟的结果相同：
+ *端口只在有流发送完毕之后才可能从排队区取出流，没有事件的时刻什么都不会发生；
+ *两个时刻之间调度区中的流只增不减，只需检查前一个时刻和后一个时刻的前一时刻
+ *至少每CHECKPOINT条结果在时刻开始前保存一次状态，重新模拟从最早被修改的时刻之前的检查点开始；
+ *越过最后一个被修改的时刻之后，每到一个检查点就和上次的状态比较，相同则后面的模拟也相同，直接得出分数
+ *有单独看就不合法的结果（流或端口id不存在、早于进入设备时间、带宽大于端口最大带宽），
+ *或者不是每个流恰好出现一次时，按排序后的顺序逐条从头模拟，给出与BasicChecker相同的第一个错误*/
+template<class R>
+class BasicIncrementalChecker {
+public:
+	static const int CHECKPOINT = 256;
+
+	BasicIncrementalChecker(const std::vector<Flow> &flows, const std::vector<Port> &ports, std::vector<Result> results,
+	                        const R &rules = R());
+	int score() const;//当前结果的总时间，出错为0
+	const std::string &message() const;//当前结果出错时algorithm()输出的错误信息，没有出错为空
+	int evaluate(const std::vector<Edit> &edits, std::string *message = nullptr);//做这些修改后的总时间，不保留修改
+	int apply(const std::vector<Edit> &edits);//做这些修改并返回新的总时间
+	const std::vector<Result> &results() const;//按输入顺序的结果
+	std::vector<Result> sorted() const;//按检查顺序排列的结果
+	bool dropped(int index) const;//当前结果中第index条结果是否因排队区已满被丢弃，当前结果出错时无意义
+	long long replayed() const;//累计模拟过的时刻数
+private:
+	struct Running {
+		int release;//端口释放这个流的时刻
+		int flowid;
+		int port;
+
+		bool operator>(const Running &other) const {
+			return release > other.release;
+		}
+
+		bool operator<(const Running &other) const {
+			if (release != other.release)
+				return release < other.release;
+			if (flowid != other.flowid)
+				return flowid < other.flowid;
+			return port < other.port;
+		}
+
+		bool operator!=(const Running &other) const {
+			return release != other.release || flowid != other.flowid || port != other.port;
+		}
+	};
+
+	struct State {
+		int time = 0;
+		int sent = 0;
+		int queued = 0;
+		int maxend = 0;
+		long long overflowtime = 0;
+		std::vector<int> speed;//端口剩余带宽
+		std::vector<Running> running;//正在发送的流，按释放时刻的最小堆
+		PortQueues<R> waitqueues;//排队区中存放流id
+
+		State() : waitqueues(0) {}
+
+		explicit State(const std::vector<int> &maxspeed) : speed(maxspeed), waitqueues((int) maxspeed.size()) {}
+	};
+
+	/*一个发送时刻的全部结果，groups[p]为发到端口p的结果序号（升序），最后一组为端口id不存在的结果*/
+	struct Tick {
+		std::vector<std::vector<int>> groups;
+		std::vector<std::vector<long long>> needs;//needs[p][i]为groups[p]前i条结果的发送所需时间之和
+		std::vector<int> firstdrop;//上次模拟时groups[p]中第一条被丢弃的结果
+		int count = 0;
+		bool saved = false;//state为这个时刻开始之前的状态
+		State state;
+	};
+
+	//模拟时用到的流的数据，按流id存放在一起
+	struct Info {
+		int speed;
+		int begintime;
+		int needtime;
+	};
+
+	R rules;
+	int maxcachesize;
+	std::vector<int> ids;//flows中流id的顺序，用于找出第一个未被发送的流
+	std::vector<Info> info;
+	std::vector<int> maxspeeds;
+	std::vector<int> arrivals;//按升序排列的begintime，用于计算某一时刻已进入设备的流数量
+	std::vector<Result> list;
+	std::map<int, Tick> ticks;
+	std::vector<int> counts;//每个流id在结果中出现的次数
+	int imperfect;//出现次数不为1的流和流id不存在的结果数量
+	int invalid;//单独看就不合法的结果数量
+	bool perfect;//当前结果没有不合法的结果且每个流恰好出现一次
+	int validto;//发送时刻不超过validto的检查点与当前结果一致
+	int current;
+	std::string error;
+	long long work;
+	State initial;
+	State scratch;
+	std::vector<int> touched;
+	std::vector<char> issend;
+	std::vector<Running> left;
+	std::vector<Running> right;
+
+	bool wrong(const Result &r) const;
+	int bucket(const Result &r) const;
+	void count(int flowid, int delta);
+	void prefix(Tick &tick, int port, int from);
+	void insert(int index);
+	void erase(int index);
+	void set(int index, const Result &r, int &lo, int &hi);
+	bool bufferok(const State &s, int time) const;
+	void start(State &s, int flowid, int port, int time) const;
+	void release(State &s);
+	bool advance(State &s, int time);
+	int finish(State &s);
+	bool same(const State &a, const State &b);
+	int replay(int from, int last, bool record, std::string &msg);
+	int replaystrict(std::string &msg);
+};
+
+template<class R>
+inline BasicIncrementalChecker<R>::BasicIncrementalChecker(const std::vector<Flow> &flows,
+                                                           const std::vector<Port> &ports,
+                                                           std::vector<Result> results, const R &r)
+		: rules(r), list(std::move(results)) {
+	maxcachesize = rules.bufferFactor * (int) ports.size();
+	info.resize(flows.size());
+	for (const Flow &flow: flows) {
+		ids.push_back(flow.id);
+		info[flow.id] = {flow.speed, flow.begintime, flow.needtime};
+		arrivals.push_back(flow.begintime);
+	}
+	for (const Port &port: ports)
+		maxspeeds.push_back(port.maxspeed);
+	std::sort(arrivals.begin(), arrivals.end());
+	counts.assign(flows.size(), 0);
+	imperfect = (int) flows.size();//都出现0次
+	invalid = 0;
+	for (int i = 0; i < (int) list.size(); ++i) {
+		count(list[i].flowid, 1);
+		invalid += wrong(list[i]);
+		insert(i);
+	}
+	initial = State(maxspeeds);
+	perfect = false;
+	validto = INT_MIN;
+	work = 0;
+	current = replay(INT_MIN, INT_MAX, true, error);
+	perfect = imperfect == 0 && invalid == 0;
+}
+
+template<class R>
+inline int BasicIncrementalChecker<R>::score() const {
+	return current;
+}
+
+template<class R>
+inline const std::string &BasicIncrementalChecker<R>::message() const {
+	return error;
+}
+
+template<class R>
+inline const std::vector<Result> &BasicIncrementalChecker<R>::results() const {
+	return list;
+}
+
+template<class R>
+inline std::vector<Result> BasicIncrementalChecker<R>::sorted() const {
+	std::vector<Result> res;
+	std::vector<int> slots;
+	res.reserve(list.size());
+	for (const auto &tick: ticks) {
+		slots.clear();
+		for (const auto &group: tick.second.groups)
+			slots.insert(slots.end(), group.begin(), group.end());
+		std::sort(slots.begin(), slots.end());
+		for (int i: slots)
+			res.push_back(list[i]);
+	}
+	return res;
+}
+
+template<class R>
+inline bool BasicIncrementalChecker<R>::dropped(int index) const {
+	const Tick &tick = ticks.at(list[index].sendtime);
+	int port = bucket(list[index]);
+	const std::vector<int> &group = tick.groups[port];
+	return std::lower_bound(group.begin(), group.end(), index) - group.begin() >= tick.firstdrop[port];
+}
+
+template<class R>
+inline long long BasicIncrementalChecker<R>::replayed() const {
+	return work;
+}
+
+template<class R>
+inline bool BasicIncrementalChecker<R>::wrong(const Result &r) const {
+	if (r.flowid < 0 || r.flowid >= (int) info.size() || r.portid < 0 || r.portid >= (int) maxspeeds.size())
+		return true;
+	const Info &flow = info[r.flowid];
+	return r.sendtime < flow.begintime || flow.speed > maxspeeds[r.portid];
+}
+
+template<class R>
+inline int BasicIncrementalChecker<R>::bucket(const Result &r) const {
+	return r.portid >= 0 && r.portid < (int) maxspeeds.size() ? r.portid : (int) maxspeeds.size();
+}
+
+template<class R>
+inline void BasicIncrementalChecker<R>::count(int flowid, int delta) {
+	if (flowid < 0 || flowid >= (int) counts.size()) {
+		imperfect += delta;
+		return;
+	}
+	if (counts[flowid] != 1)
+		--imperfect;
+	counts[flowid] += delta;
+	if (counts[flowid] != 1)
+		++imperfect;
+}
+
+/*从groups[port]的第from条起重算前缀和，并把这一组标记为没有被丢弃的结果*/
+template<class R>
+inline void BasicIncrementalChecker<R>::prefix(Tick &tick, int port, int from) {
+	const std::vector<int> &group = tick.groups[port];
+	std::vector<long long> &need = tick.needs[port];
+	need.resize(group.size() + 1);
+	for (int i = from; i < (int) group.size(); ++i) {
+		int flowid = list[group[i]].flowid;
+		need[i + 1] = need[i] + (flowid >= 0 && flowid < (int) info.size() ? info[flowid].needtime : 0);
+	}
+	tick.firstdrop[port] = (int) group.size();
+}
+
+template<class R>
+inline void BasicIncrementalChecker<R>::insert(int index) {
+	Tick &tick = ticks[list[index].sendtime];
+	if (tick.groups.empty()) {
+		tick.groups.resize(maxspeeds.size() + 1);
+		tick.needs.assign(maxspeeds.size() + 1, std::vector<long long>(1, 0));
+		tick.firstdrop.assign(maxspeeds.size() + 1, 0);
+	}
+	int port = bucket(list[index]);
+	std::vector<int> &group = tick.groups[port];
+	auto pos = group.insert(std::lower_bound(group.begin(), group.end(), index), index);
+	prefix(tick, port, (int) (pos - group.begin()));
+	++tick.count;
+}
+
+template<class R>
+inline void BasicIncrementalChecker<R>::erase(int index) {
+	auto it = ticks.find(list[index].sendtime);
+	Tick &tick = it->second;
+	if (--tick.count == 0) {//没有结果的时刻不能留下，否则会推迟模拟结束的时刻
+		ticks.erase(it);
+		return;
+	}
+	int port = bucket(list[index]);
+	std::vector<int> &group = tick.groups[port];
+	auto pos = group.erase(std::lower_bound(group.begin(), group.end(), index));
+	prefix(tick, port, (int) (pos - group.begin()));
+}
+
+/*修改第index条结果，[lo, hi]扩大到包含新旧两个发送时刻*/
+template<class R>
+inline void BasicIncrementalChecker<R>::set(int index, const Result &r, int &lo, int &hi) {
+	lo = std::min(lo, std::min(list[index].sendtime, r.sendtime));
+	hi = std::max(hi, std::max(list[index].sendtime, r.sendtime));
+	erase(index);
+	count(list[index].flowid, -1);
+	invalid -= wrong(list[index]);
+	list[index] = r;
+	count(r.flowid, 1);
+	invalid += wrong(r);
+	insert(index);
+}
+
+template<class R>
+inline bool BasicIncrementalChecker<R>::bufferok(const State &s, int time) const {
+	if (!R::queueing)
+		return true;
+	int arrived = (int) (std::upper_bound(arrivals.begin(), arrivals.end(), time) - arrivals.begin());
+	return arrived - s.sent <= maxcachesize;
+}
+
+template<class R>
+inline void BasicIncrementalChecker<R>::start(State &s, int flowid, int port, int time) const {
+	const Info &flow = info[flowid];
+	s.speed[port] -= flow.speed;
+	s.maxend = std::max(s.maxend, time + flow.needtime);
+	//同一时刻只释放一次端口，本时刻开始发送的流最早下一时刻释放
+	s.running.push_back({time + std::max(flow.needtime, 1), flowid, port});
+	std::push_heap(s.running.begin(), s.running.end(), std::greater<>());
+}
+
+/*释放最早一批发送完毕的流，这些端口再从排队区取出放得下的流开始发送*/
+template<class R>
+inline void BasicIncrementalChecker<R>::release(State &s) {
+	int time = s.running.front().release;
+	touched.clear();
+	while (!s.running.empty() && s.running.front().release == time) {
+		const Running &r = s.running.front();
+		s.speed[r.port] += info[r.flowid].speed;
+		touched.push_back(r.port);
+		std::pop_heap(s.running.begin(), s.running.end(), std::greater<>());
+		s.running.pop_back();
+	}
+	for (int port: touched) {
+		while (!s.waitqueues.empty(port) && info[s.waitqueues.front(port)].speed <= s.speed[port]) {
+			start(s, s.waitqueues.front(port), port, time);
+			s.waitqueues.pop(port);
+			--s.queued;
+		}
+	}
+}
+
+/*结束s.time时刻，处理到time时刻（含）为止发送完毕的流*/
+template<class R>
+inline bool BasicIncrementalChecker<R>::advance(State &s, int time) {
+	if (!bufferok(s, s.time) || !bufferok(s, time - 1))
+		return false;
+	while (!s.running.empty() && s.running.front().release <= time)
+		release(s);
+	s.time = time;
+	return true;
+}
+
+/*BasicChecker最后逐时刻把排队区发送完，总时间为排队区全部清空的时刻和最晚发送完毕时刻中较大的一个*/
+template<class R>
+inline int BasicIncrementalChecker<R>::finish(State &s) {
+	int end = s.time;
+	while (s.queued > 0) {
+		end = s.running.front().release;
+		release(s);
+	}
+	long long total = std::max(end, s.maxend) + s.overflowtime;
+	return total > INT_MAX ? INT_MAX : (int) total;
+}
+
+/*两个状态除罚时以外是否相同，正在发送的流按集合比较*/
+template<class R>
+inline bool BasicIncrementalChecker<R>::same(const State &a, const State &b) {
+	if (a.time != b.time || a.sent != b.sent || a.queued != b.queued || a.maxend != b.maxend ||
+	    a.speed != b.speed || a.running.size() != b.running.size() || !(a.waitqueues == b.waitqueues))
+		return false;
+	bool equal = true;
+	for (size_t i = 0; i < a.running.size() && equal; ++i)
+		equal = !(a.running[i] != b.running[i]);
+	if (equal)
+		return true;
+	left = a.running;
+	right = b.running;
+	std::sort(left.begin(), left.end());
+	std::sort(right.begin(), right.end());
+	for (size_t i = 0; i < left.size(); ++i) {
+		if (left[i] != right[i])
+			return false;
+	}
+	return true;
+}
+
+/*被修改的发送时刻都在[from, last]之间，从from之前最近的检查点开始逐个时刻模拟，record为true时更新检查点和丢弃标记*/
+template<class R>
+inline int BasicIncrementalChecker<R>::replay(int from, int last, bool record, std::string &msg) {
+	if (list.size() < counts.size()) {
+		msg = "有流缺失，或数据输出格式有误";
+		return 0;
+	}
+	if (imperfect > 0 || invalid > 0) {
+		if (record)
+			validto = INT_MIN;
+		return replaystrict(msg);
+	}
+	//修改前后都合法且每个流恰好出现一次时，后面的结果相同且状态相同就一定得到相同的结论
+	bool converge = perfect;
+	std::string previous = converge ? error : std::string();//msg可能就是error
+	msg.clear();
+	int oldvalid = validto;
+	State &s = scratch;
+	auto it = ticks.upper_bound(std::min(from, validto));
+	while (it != ticks.begin() && !std::prev(it)->second.saved)
+		--it;
+	if (it == ticks.begin()) {
+		s = initial;
+	} else {
+		--it;
+		s = it->second.state;
+	}
+	int since = CHECKPOINT;
+	int ports = (int) maxspeeds.size();
+	for (; it != ticks.end(); ++it) {
+		int t = it->first;
+		Tick &tick = it->second;
+		if (converge && t > last && t <= oldvalid && tick.saved && same(s, tick.state)) {
+			//后面的模拟与修改前相同，只有罚时相差一个常数
+			long long delta = s.overflowtime - tick.state.overflowtime;
+			if (record) {
+				for (; it != ticks.end() && it->first <= oldvalid; ++it) {
+					if (it->second.saved)
+						it->second.state.overflowtime += delta;
+				}
+				validto = oldvalid;
+			}
+			msg = previous;
+			return current == 0 ? 0 : (int) (current + delta);
+		}
+		if (record) {
+			tick.saved = since >= CHECKPOINT;
+			if (tick.saved) {
+				tick.state = s;
+				since = 0;
+			}
+			validto = t;
+		}
+		++work;
+		if (t > s.time && !advance(s, t)) {
+			msg = "流调度区爆了！";
+			return 0;
+		}
+		for (int p = 0; p < ports; ++p) {
+			const std::vector<int> &group = tick.groups[p];
+			int i = 0;
+			for (; i < (int) group.size(); ++i) {
+				int flowid = list[group[i]].flowid;
+				if (s.waitqueues.empty(p) && info[flowid].speed <= s.speed[p]) {
+					start(s, flowid, p, t);
+				} else if (R::queueing && s.waitqueues.size(p) >= rules.queueLimit) {
+					//排队区满了，这个时刻后面发到这个端口的流都被丢弃
+					s.overflowtime += (long long) rules.penalty * (tick.needs[p][group.size()] - tick.needs[p][i]);
+					break;
+				} else {
+					s.waitqueues.push(p, flowid);
+					++s.queued;
+				}
+			}
+			if (record)
+				tick.firstdrop[p] = i;
+		}
+		s.sent += tick.count;
+		since += tick.count;
+	}
+	if (record)
+		validto = INT_MAX;
+	if (!bufferok(s, s.time)) {
+		msg = "流调度区爆了！";
+		return 0;
+	}
+	return finish(s);
+}
+
+/*逐条模拟并按BasicChecker的顺序检查每一条结果*/
+template<class R>
+inline int BasicIncrementalChecker<R>::replaystrict(std::string &msg) {
+	msg.clear();
+	issend.assign(counts.size(), 0);
+	State &s = scratch;
+	s = initial;
+	auto fail = [&](const char *what, const Result &r) {
+		msg = what + std::to_string(r.flowid) + ',' + std::to_string(r.portid) + ',' + std::to_string(r.sendtime);
+		return 0;
+	};
+	for (const Result &r: sorted()) {
+		int t = r.sendtime;
+		if (t > s.time) {
+			++work;
+			if (!advance(s, t)) {
+				msg = "流调度区爆了！";
+				return 0;
+			}
+		}
+		if (r.flowid >= (int) counts.size() || r.flowid < 0)
+			return fail("流id不存在，错误结果为", r);
+		if (r.portid >= (int) maxspeeds.size() || r.portid < 0)
+			return fail("端口id不存在，错误结果为", r);
+		const Info &flow = info[r.flowid];
+		if (t < flow.begintime)
+			return fail("流发送时间小于进入设备时间，错误结果为", r);
+		if (flow.speed > maxspeeds[r.portid])
+			return fail("流带宽大于端口最大带宽，错误结果为", r);
+		if (issend[r.flowid])
+			return fail("流被重复发送，错误结果为", r);
+		issend[r.flowid] = 1;
+		if (s.waitqueues.empty(r.portid) && flow.speed <= s.speed[r.portid]) {
+			start(s, r.flowid, r.portid, t);
+		} else if (R::queueing && s.waitqueues.size(r.portid) >= rules.queueLimit) {
+			s.overflowtime += (long long) rules.penalty * flow.needtime;
+		} else {
+			s.waitqueues.push(r.portid, r.flowid);
+			++s.queued;
+		}
+		++s.sent;
+	}
+	if (!bufferok(s, s.time)) {
+		msg = "流调度区爆了！";
+		return 0;
+	}
+	int time = finish(s);
+	for (int id: ids) {
+		if (!issend[id]) {
+			msg = "有流未被发送，未发送的流编号为" + std::to_string(id);
+			return 0;
+		}
+	}
+	return time;
+}
+
+template<class R>
+inline int BasicIncrementalChecker<R>::evaluate(const std::vector<Edit> &edits, std::string *message) {
+	if (edits.empty()) {
+		if (message != nullptr)
+			*message = error;
+		return current;
+	}
+	std::vector<Result> saved;
+	int lo = INT_MAX;
+	int hi = INT_MIN;
+	for (const Edit &e: edits) {
+		saved.push_back(list[e.index]);
+		set(e.index, Result(e.flowid, e.portid, e.sendtime), lo, hi);
+	}
+	std::string msg;
+	int time = replay(lo, hi, false, msg);
+	for (int i = (int) edits.size() - 1; i >= 0; --i)
+		set(edits[i].index, saved[i], lo, hi);
+	if (message != nullptr)
+		*message = msg;
+	return time;
+}
+
+template<class R>
+inline int BasicIncrementalChecker<R>::apply(const std::vector<Edit> &edits) {
+	if (edits.empty())
+		return current;
+	int lo = INT_MAX;
+	int hi = INT_MIN;
+	for (const Edit &e: edits)
+		set(e.index, Result(e.flowid, e.portid, e.sendtime), lo, hi);
+	current = replay(lo, hi, true, error);
+	perfect = imperfect == 0 && invalid == 0;
+	return current;
+}
+
+//比赛规则下的增量检查器
+using IncrementalChecker = BasicIncrementalChecker<StandardRules>;
+
+}
+
+#endif //ZET_2023_INCREMENTAL_H
@@ -0,0 +1,431 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <list>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <climits>
+#include <cerrno>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include "../solve2/transfer.h"
+#include "../determine_2/checker.h"
+
+using namespace std;
+
+// 多交换机模拟: 一个舰队清单描述多台交换机, 每台交换机是 solve2 模型下的一组端口和一组流
+// 协调进程读入所有数据并分好片, 再 fork 出 --jobs 个工作进程, 每个工作进程循环领取下一台交换机 (共享内存里的计数器),
+// 用 solve2 的调度核心算出结果、用 determine_2 的检查核心计分, 把每台交换机的报告通过管道写回协调进程,
+// 协调进程汇总成舰队报告. 工作进程 fork 时继承已经读好的数据 (写时复制), 不需要再读文件, 也不需要任何外部服务
+//
+// ./fleet 清单 [--flows 流文件] [--mapping 映射文件] [--jobs N] [--seed S]
+//   清单每行一台交换机: 名称,端口文件[,流文件], # 开头的行为注释, 相对路径相对于清单所在目录
+//   --flows    : 全舰队共用的流文件 (格式同 flow.txt), 按流 id 哈希分到各台交换机, 与各交换机自己的流文件合并
+//   --mapping  : 显式给出 --flows 中流的去向, 每行 流id,交换机序号 (清单中的行号, 从 0 开始), 没有列出的流仍按哈希分配
+//   --seed     : 哈希种子, 默认 0
+//   --jobs     : 工作进程数, 默认 CPU 核数
+// 标准输出为 csv: switch,name,flows,ports,unplaced,makespan,dropped,penalty,total,seconds, 最后一行为 fleet 汇总
+//   makespan 为最后一个流发送完毕的时刻, penalty 为丢弃罚时, total = makespan + penalty (与 determine_2 的总时间相同)
+//   unplaced 为带宽超过该交换机所有端口、无法发送而没有参与模拟的流; 结果不合法时 total 为 0, 检查核心给出的原因输出到标准错误
+//   seconds 为计算这台交换机所用的 CPU 时间; fleet 行: makespan 取各交换机最大值, 其余为总和
+// 运行时间、工作进程数和并行加速比 (各交换机 CPU 时间之和 / 计算阶段的墙钟时间) 输出到标准错误
+
+// 流只保存 带宽、进入时间、发送所需时间 三个整数, 工作进程只读, fork 之后的页面不会被复制;
+// 调度用的 solver::Flow 链表由工作进程为自己领到的交换机单独构造
+struct FlowShape {
+	int bandwidth;
+	int startTime;
+	int sendTime;
+};
+
+class Switch {
+public:
+	string name;
+	vector<solver::Port> ports;
+	vector<FlowShape> flows;
+	int maxBandwidth = 0;
+	int unplaced = 0;
+};
+
+// 一台交换机的报告, 以定长记录写入管道 (小于 PIPE_BUF, 一次 write 不会和其它进程的记录交错)
+struct ShardReport {
+	int shard;
+	int flows;
+	int ports;
+	int unplaced;
+	int makespan;
+	int dropped;
+	int penalty;
+	int total;
+	double seconds;
+	// 结果不合法时检查核心的出错信息, 以 '\0' 结尾, 过长时截断
+	char message[64];
+};
+
+// 按流 id 哈希分配交换机 (splitmix64)
+int hashShard(int id, uint64_t seed, int shards) {
+	uint64_t x = (uint64_t) id + seed + 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return (int) (x % (uint64_t) shards);
+}
+
+string resolve(const string &base, const string &path) {
+	if (path.empty() || path[0] == '/' || base.empty()) {
+		return path;
+	}
+	return base + "/" + path;
+}
+
+// 流加入交换机, 带宽超过所有端口的流只计数
+void place(Switch &sw, int bandwidth, int startTime, int sendTime) {
+	if (bandwidth > sw.maxBandwidth) {
+		++sw.unplaced;
+		return;
+	}
+	sw.flows.push_back({bandwidth, startTime, sendTime});
+}
+
+// 读取流文件 (格式同 flow.txt), 每个流交给 fn(id, 带宽, 进入时间, 发送所需时间)
+template<class F>
+bool loadFlows(const string &path, F &&fn) {
+	FILE *in = fopen(path.c_str(), "r");
+	if (in == nullptr) {
+		return false;
+	}
+	// 忽略第一行
+	fscanf(in, "%*[^\n]%*c");
+	int id, bandwidth, startTime, sendTime;
+	while (fscanf(in, "%d,%d,%d,%d\n", &id, &bandwidth, &startTime, &sendTime) == 4) {
+		fn(id, bandwidth, startTime, sendTime);
+	}
+	fclose(in);
+	return true;
+}
+
+bool loadManifest(const string &manifest, vector<Switch> &switches) {
+	ifstream in(manifest);
+	if (!in.is_open()) {
+		cerr << "找不到清单 " << manifest << endl;
+		return false;
+	}
+	size_t slash = manifest.find_last_of('/');
+	string base = slash == string::npos ? "" : manifest.substr(0, slash);
+	string line;
+	while (getline(in, line)) {
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		stringstream fields(line);
+		string name, portFile, flowFile;
+		getline(fields, name, ',');
+		getline(fields, portFile, ',');
+		getline(fields, flowFile, ',');
+		Switch sw;
+		sw.name = name;
+		solver::loadPort(resolve(base, portFile).c_str(), sw.ports);
+		if (sw.ports.empty()) {
+			cerr << "交换机 " << name << " 没有端口：" << resolve(base, portFile) << endl;
+			return false;
+		}
+		for (const auto &port: sw.ports) {
+			sw.maxBandwidth = max(sw.maxBandwidth, port.bandwidth);
+		}
+		if (!flowFile.empty() && !loadFlows(resolve(base, flowFile), [&](int, int bandwidth, int startTime, int sendTime) {
+			place(sw, bandwidth, startTime, sendTime);
+		})) {
+			cerr << "交换机 " << name << " 找不到流文件：" << resolve(base, flowFile) << endl;
+			return false;
+		}
+		switches.push_back(move(sw));
+	}
+	return !switches.empty();
+}
+
+// 计算一台交换机: 与 solve2 相同, 两组权重各调度一次取 transfer 返回值较小的, 再按 determine_2 的规则计分
+// 工作进程的 CPU 时间 (秒), 工作进程比 CPU 核多时墙钟时间会把等待调度的时间也算进去
+double cpuSeconds() {
+	timespec ts{};
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+ShardReport simulate(int shard, const Switch &sw) {
+	double begin = cpuSeconds();
+	ShardReport report{};
+	report.shard = shard;
+	report.flows = (int) sw.flows.size();
+	report.ports = (int) sw.ports.size();
+	report.unplaced = sw.unplaced;
+	// 检查核心要求流 id 为 0..n-1, 每台交换机内按加入的顺序重新编号
+	list<solver::Flow> flowList;
+	for (const auto &flow: sw.flows) {
+		flowList.emplace_back((int) flowList.size(), flow.bandwidth, flow.startTime, flow.sendTime);
+	}
+	flowList.sort([](solver::Flow &first, solver::Flow &second) {
+		if (first.startTime != second.startTime) {
+			return first.startTime < second.startTime;
+		} else if (first.bandwidth != second.bandwidth) {
+			return first.bandwidth < second.bandwidth;
+		} else {
+			return first.sendTime < second.sendTime;
+		}
+	});
+	vector<vector<int>> temp(flowList.size(), vector<int>(3));
+	vector<vector<int>> results;
+	int best = INT_MAX;
+	double weights[2][2] = {{2.3, -7.9}, {0.8, 0.0}};
+	for (auto &w: weights) {
+		int ret = solver::transfer(flowList, sw.ports, temp, w[0], w[1]);
+		if (ret < best) {
+			best = ret;
+			results.swap(temp);
+			temp.assign(flowList.size(), vector<int>(3));
+		}
+	}
+	vector<checker::Flow> flows;
+	for (const auto &flow: flowList) {
+		flows.emplace_back(flow.id, flow.bandwidth, flow.startTime, flow.sendTime);
+	}
+	stable_sort(flows.begin(), flows.end(),
+	            [](const checker::Flow &x, const checker::Flow &y) { return x.begintime < y.begintime; });
+	vector<checker::Port> ports;
+	for (const auto &port: sw.ports) {
+		ports.emplace_back(port.id, port.bandwidth);
+	}
+	// 出错信息带回协调进程, 不写到工作进程的标准输出里
+	ostringstream message;
+	checker::errorstream() = &message;
+	checker::Checker check(flows, ports);
+	bool ok = true;
+	for (const auto &r: results) {
+		if (!check.push(checker::Result(r[0], r[1], r[2]))) {
+			ok = false;
+			break;
+		}
+		report.dropped += check.dropped();
+	}
+	report.total = ok ? check.finish() : 0;
+	checker::errorstream() = &cout;
+	string text = message.str();
+	while (!text.empty() && text.back() == '\n') {
+		text.pop_back();
+	}
+	// 截断时不留下半个 UTF-8 字符
+	size_t len = min(text.size(), sizeof(report.message) - 1);
+	while (len < text.size() && len > 0 && ((unsigned char) text[len] & 0xC0) == 0x80) {
+		--len;
+	}
+	memcpy(report.message, text.data(), len);
+	report.message[len] = '\0';
+	report.penalty = check.overflow();
+	report.makespan = report.total > 0 ? report.total - report.penalty : 0;
+	report.seconds = cpuSeconds() - begin;
+	return report;
+}
+
+// 工作进程: 从共享计数器领取交换机, 报告写入管道
+void work(const vector<Switch> &switches, int *next, int fd) {
+	int shard;
+	while ((shard = __atomic_fetch_add(next, 1, __ATOMIC_RELAXED)) < (int) switches.size()) {
+		ShardReport report = simulate(shard, switches[shard]);
+		if (write(fd, &report, sizeof(report)) != (ssize_t) sizeof(report)) {
+			break;
+		}
+	}
+	close(fd);
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		cerr << "用法：./fleet 清单 [--flows 流文件] [--mapping 映射文件] [--jobs N] [--seed S]" << endl;
+		return 1;
+	}
+	string manifest = argv[1];
+	string flowFile;
+	string mappingFile;
+	int jobs = (int) thread::hardware_concurrency();
+	uint64_t seed = 0;
+	for (int i = 2; i < argc; ++i) {
+		if (strcmp(argv[i], "--flows") == 0 && i + 1 < argc) {
+			flowFile = argv[++i];
+		} else if (strcmp(argv[i], "--mapping") == 0 && i + 1 < argc) {
+			mappingFile = argv[++i];
+		} else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+			jobs = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], nullptr, 10);
+		}
+	}
+	auto begin = chrono::steady_clock::now();
+	vector<Switch> switches;
+	if (!loadManifest(manifest, switches)) {
+		return 1;
+	}
+	int shards = (int) switches.size();
+	if (!flowFile.empty()) {
+		// 显式映射: 流 id -> 交换机, 没有列出的为 -1
+		vector<int> mapping;
+		if (!mappingFile.empty()) {
+			FILE *in = fopen(mappingFile.c_str(), "r");
+			if (in == nullptr) {
+				cerr << "找不到映射文件 " << mappingFile << endl;
+				return 1;
+			}
+			int id, shard;
+			while (fscanf(in, "%d,%d\n", &id, &shard) == 2) {
+				if (id < 0 || shard < 0 || shard >= shards) {
+					cerr << "映射有误：" << id << ',' << shard << endl;
+					fclose(in);
+					return 1;
+				}
+				if (id >= (int) mapping.size()) {
+					mapping.resize(id + 1, -1);
+				}
+				mapping[id] = shard;
+			}
+			fclose(in);
+		}
+		if (!loadFlows(flowFile, [&](int id, int bandwidth, int startTime, int sendTime) {
+			int shard = id >= 0 && id < (int) mapping.size() && mapping[id] >= 0 ? mapping[id]
+			                                                                      : hashShard(id, seed, shards);
+			place(switches[shard], bandwidth, startTime, sendTime);
+		})) {
+			cerr << "找不到流文件 " << flowFile << endl;
+			return 1;
+		}
+	}
+	double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+	// 工作进程领取交换机的计数器, 放在进程间共享的匿名映射里
+	int *next = (int *) mmap(nullptr, sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (next == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	*next = 0;
+	jobs = max(1, min(jobs, shards));
+	auto start = chrono::steady_clock::now();
+	fflush(stdout);
+	fflush(stderr);
+	vector<pid_t> workers;
+	vector<pollfd> pipes;
+	for (int i = 0; i < jobs; ++i) {
+		int fds[2];
+		if (pipe(fds) != 0) {
+			perror("pipe");
+			break;
+		}
+		pid_t pid = fork();
+		if (pid == 0) {
+			close(fds[0]);
+			for (const auto &p: pipes) {
+				close(p.fd);
+			}
+			work(switches, next, fds[1]);
+			// _exit 不会刷新缓冲区
+			cout.flush();
+			fflush(stdout);
+			fflush(stderr);
+			_exit(0);
+		}
+		close(fds[1]);
+		if (pid < 0) {
+			perror("fork");
+			close(fds[0]);
+			break;
+		}
+		workers.push_back(pid);
+		pipes.push_back({fds[0], POLLIN, 0});
+	}
+	if (workers.empty()) {
+		return 1;
+	}
+
+	vector<ShardReport> reports(shards);
+	vector<char> done(shards, 0);
+	int open = (int) pipes.size();
+	while (open > 0) {
+		if (poll(pipes.data(), pipes.size(), -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("poll");
+			break;
+		}
+		for (auto &p: pipes) {
+			if (p.fd < 0 || p.revents == 0) {
+				continue;
+			}
+			ShardReport report;
+			ssize_t n = read(p.fd, &report, sizeof(report));
+			if (n == (ssize_t) sizeof(report) && report.shard >= 0 && report.shard < shards) {
+				reports[report.shard] = report;
+				done[report.shard] = 1;
+			} else if (n <= 0) {
+				close(p.fd);
+				p.fd = -1;
+				--open;
+			}
+		}
+	}
+	for (pid_t pid: workers) {
+		waitpid(pid, nullptr, 0);
+	}
+	munmap(next, sizeof(int));
+	double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	printf("switch,name,flows,ports,unplaced,makespan,dropped,penalty,total,seconds\n");
+	long long flows = 0, ports = 0, unplaced = 0, dropped = 0, penalty = 0, total = 0;
+	int makespan = 0;
+	double seconds = 0;
+	int failed = 0;
+	for (int i = 0; i < shards; ++i) {
+		if (!done[i]) {
+			// 工作进程异常退出, 这台交换机没有报告
+			printf("%d,%s,%zu,%zu,%d,,,,0,\n", i, switches[i].name.c_str(), switches[i].flows.size(),
+			       switches[i].ports.size(), switches[i].unplaced);
+			++failed;
+			continue;
+		}
+		const ShardReport &r = reports[i];
+		printf("%d,%s,%d,%d,%d,%d,%d,%d,%d,%.3f\n", i, switches[i].name.c_str(), r.flows, r.ports, r.unplaced,
+		       r.makespan, r.dropped, r.penalty, r.total, r.seconds);
+		if (r.total == 0) {
+			++failed;
+			fprintf(stderr, "交换机 %d（%s）结果不合法：%s\n", i, switches[i].name.c_str(),
+			        r.message[0] != '\0' ? r.message : "检查器没有给出原因");
+		}
+		flows += r.flows;
+		ports += r.ports;
+		unplaced += r.unplaced;
+		dropped += r.dropped;
+		penalty += r.penalty;
+		total += r.total;
+		makespan = max(makespan, r.makespan);
+		seconds += r.seconds;
+	}
+	printf("fleet,,%lld,%lld,%lld,%d,%lld,%lld,%lld,%.3f\n", flows, ports, unplaced, makespan, dropped, penalty, total,
+	       seconds);
+	fprintf(stderr, "%d 台交换机，%d 个工作进程，读取 %.2f 秒，计算 %.2f 秒，各交换机 CPU 时间之和 %.2f 秒，加速比 %.2f\n", shards,
+	        (int) workers.size(), loadSeconds, wall, seconds, wall > 0 ? seconds / wall : 0.0);
+	if (failed > 0) {
+		fprintf(stderr, "%d 台交换机没有得到合法结果\n", failed);
+		return 1;
+	}
+	return 0;
+}
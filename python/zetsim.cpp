@@ -0,0 +1,480 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <vector>
+#include <list>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "../solve2/transfer.h"
+#include "../determine_2/checker.h"
+
+using namespace std;
+
+// Python 扩展模块 zetsim: 在 notebook 里直接调用 solve2 的调度核心和 determine_2 的检查核心, 不再经过文件
+//   load_flows(path) / load_ports(path) / load_results(path) : 读取 flow.txt / port.txt / result.txt,
+//       返回 Table (int32 的二维数组, 每行一个流 / 端口 / 结果), np.asarray(table) 直接使用这块内存, 不复制
+//   transfer(flows, ports, a, b, c=0, rules=2) -> (transfer 返回值, 结果 Table)
+//   score(flows, ports, results, rules=2) -> 检查器总时间, 结果不合法时为 0 (与 determine_2 相同)
+//   sweep(flows, ports, weights, c=0, rules=2, threads=0) -> 每组权重的检查器总时间 (一维 Table)
+//       weights 为 k x 2 的 float64 数组 (a, b), 计算期间释放 GIL, threads 个线程并行 (0 为 CPU 核数)
+// 参数中的数组可以是 numpy 数组 (int32 / float64, C 连续) 或 Table, 也可以是其它支持缓冲区协议的对象
+// flows 的 id 须为 0..n-1、ports 的 id 须为 0..m-1 (顺序不限, 各出现一次), 每个流至少有一个端口放得下, 否则为 ValueError
+// rules 为 1 时按 solve1 / determine_1 的规则 (没有排队区上限), 见 common/rules.h
+// 不依赖 pybind11 和 numpy 头文件, 只用 CPython 的 C API 和缓冲区协议
+
+// 模块返回的数组, 拥有自己的 int32 数据
+struct TableObject {
+	PyObject_HEAD
+	vector<int> *data;
+	int ndim;
+	Py_ssize_t shape[2];
+	Py_ssize_t strides[2];
+	PyObject *columns;
+};
+
+static void tableDealloc(TableObject *self) {
+	delete self->data;
+	Py_XDECREF(self->columns);
+	Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static int tableGetBuffer(TableObject *self, Py_buffer *view, int flags) {
+	view->obj = (PyObject *) self;
+	Py_INCREF(self);
+	view->buf = self->data->data();
+	view->len = (Py_ssize_t) (self->data->size() * sizeof(int));
+	view->readonly = 0;
+	view->itemsize = sizeof(int);
+	view->format = (flags & PyBUF_FORMAT) == PyBUF_FORMAT ? (char *) "i" : nullptr;
+	view->ndim = self->ndim;
+	view->shape = (flags & PyBUF_ND) == PyBUF_ND ? self->shape : nullptr;
+	view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : nullptr;
+	view->suboffsets = nullptr;
+	view->internal = nullptr;
+	return 0;
+}
+
+static Py_ssize_t tableLength(TableObject *self) {
+	return self->shape[0];
+}
+
+static PyObject *tableColumns(TableObject *self, void *) {
+	Py_INCREF(self->columns);
+	return self->columns;
+}
+
+static PyObject *tableShape(TableObject *self, void *) {
+	if (self->ndim == 1) {
+		return Py_BuildValue("(n)", self->shape[0]);
+	}
+	return Py_BuildValue("(nn)", self->shape[0], self->shape[1]);
+}
+
+static PyBufferProcs tableBuffer = {(getbufferproc) tableGetBuffer, nullptr};
+
+static PySequenceMethods tableSequence;
+
+static PyGetSetDef tableGetSet[] = {
+		{"columns", (getter) tableColumns, nullptr, "列名", nullptr},
+		{"shape",   (getter) tableShape,   nullptr, "行数和列数", nullptr},
+		{nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+// 其余各项在 PyInit_zetsim 中填写
+static PyTypeObject TableType = [] {
+	PyTypeObject type{};
+	type.ob_base = PyVarObject{PyObject_HEAD_INIT(nullptr) 0};
+	return type;
+}();
+
+// 取得 data 的所有权; names 为空时是一维数组
+static PyObject *newTable(vector<int> *data, const vector<const char *> &names) {
+	TableObject *self = PyObject_New(TableObject, &TableType);
+	if (self == nullptr) {
+		delete data;
+		return nullptr;
+	}
+	Py_ssize_t cols = max((Py_ssize_t) names.size(), (Py_ssize_t) 1);
+	self->data = data;
+	self->ndim = names.empty() ? 1 : 2;
+	self->shape[0] = (Py_ssize_t) data->size() / cols;
+	self->shape[1] = cols;
+	self->strides[0] = cols * (Py_ssize_t) sizeof(int);
+	self->strides[1] = sizeof(int);
+	self->columns = PyTuple_New((Py_ssize_t) names.size());
+	for (int i = 0; i < (int) names.size(); ++i) {
+		PyTuple_SET_ITEM(self->columns, i, PyUnicode_FromString(names[i]));
+	}
+	return (PyObject *) self;
+}
+
+static const vector<const char *> flowColumns = {"id", "bandwidth", "startTime", "sendTime"};
+static const vector<const char *> portColumns = {"id", "bandwidth"};
+static const vector<const char *> resultColumns = {"flow", "port", "time"};
+
+// 以 rows x cols 的 C 连续数组读取 obj, 元素类型为 type ('i' 为 int32, 'd' 为 float64)
+// 成功时 view 需要由调用者 PyBuffer_Release, 失败时设置异常
+class BufferView {
+public:
+	Py_buffer view{};
+	Py_ssize_t rows = 0;
+	bool ok = false;
+
+	BufferView(PyObject *obj, int cols, char type, const char *name);
+	~BufferView();
+	const int *ints() const;
+	const double *doubles() const;
+};
+
+BufferView::BufferView(PyObject *obj, int cols, char type, const char *name) {
+	if (PyObject_GetBuffer(obj, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+		return;
+	}
+	const char *format = view.format == nullptr ? "B" : view.format;
+	if (strchr("@=<", format[0]) != nullptr) {
+		++format;
+	}
+	size_t itemsize = type == 'd' ? sizeof(double) : sizeof(int);
+	bool typeOk = format[0] == type && format[1] == '\0' && view.itemsize == (Py_ssize_t) itemsize;
+	bool shapeOk = (view.ndim == 2 && view.shape[1] == cols) || (view.ndim == 1 && view.shape[0] % cols == 0);
+	if (!typeOk || !shapeOk) {
+		// PyErr_Format 的格式串只能是 ASCII
+		char message[128];
+		snprintf(message, sizeof(message), "%s 应为 n x %d 的 C 连续 %s 数组", name, cols,
+		         type == 'd' ? "float64" : "int32");
+		PyErr_SetString(PyExc_TypeError, message);
+		PyBuffer_Release(&view);
+		return;
+	}
+	rows = view.len / view.itemsize / cols;
+	ok = true;
+}
+
+BufferView::~BufferView() {
+	if (ok) {
+		PyBuffer_Release(&view);
+	}
+}
+
+const int *BufferView::ints() const {
+	return (const int *) view.buf;
+}
+
+const double *BufferView::doubles() const {
+	return (const double *) view.buf;
+}
+
+// 读取文本文件中每行 fields 个整数, skipHeader 时忽略第一行
+static bool readTable(const char *path, int fields, bool skipHeader, vector<int> &out) {
+	FILE *in = fopen(path, "r");
+	if (in == nullptr) {
+		return false;
+	}
+	static const char *formats[] = {"", "%d\n", "%d,%d\n", "%d,%d,%d\n", "%d,%d,%d,%d\n"};
+	if (skipHeader) {
+		fscanf(in, "%*[^\n]%*c");
+	}
+	int v[4];
+	while (fscanf(in, formats[fields], v, v + 1, v + 2, v + 3) == fields) {
+		out.insert(out.end(), v, v + fields);
+	}
+	fclose(in);
+	return true;
+}
+
+static PyObject *load(PyObject *args, int fields, bool skipHeader, const vector<const char *> &names) {
+	const char *path;
+	if (!PyArg_ParseTuple(args, "s", &path)) {
+		return nullptr;
+	}
+	auto *data = new vector<int>();
+	bool ok;
+	Py_BEGIN_ALLOW_THREADS
+	ok = readTable(path, fields, skipHeader, *data);
+	Py_END_ALLOW_THREADS
+	if (!ok) {
+		delete data;
+		return PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+	}
+	return newTable(data, names);
+}
+
+static PyObject *loadFlows(PyObject *, PyObject *args) {
+	return load(args, 4, true, flowColumns);
+}
+
+static PyObject *loadPorts(PyObject *, PyObject *args) {
+	return load(args, 2, true, portColumns);
+}
+
+static PyObject *loadResults(PyObject *, PyObject *args) {
+	return load(args, 3, false, resultColumns);
+}
+
+// 调度核心和检查核心按 id 直接下标访问流和端口, 放不下的流会让调度一直等下去, 所以进入核心之前先检查:
+// 流 id 和端口 id 各为 0 开始的连续整数 (各出现一次), 有流时至少有一个端口, 最宽的流放得下最宽的端口; 不满足时设置 ValueError
+static bool validDataset(const BufferView &flowView, const BufferView &portView) {
+	char message[160];
+	vector<char> seen(flowView.rows, 0);
+	const int *f = flowView.ints();
+	const int *widest = nullptr;
+	for (Py_ssize_t i = 0; i < flowView.rows; ++i, f += 4) {
+		if (f[0] < 0 || f[0] >= flowView.rows || seen[f[0]]) {
+			snprintf(message, sizeof(message), "flows 的 id 应为 0..%zd 且各出现一次，第 %zd 行的 id 为 %d",
+			         flowView.rows - 1, i, f[0]);
+			PyErr_SetString(PyExc_ValueError, message);
+			return false;
+		}
+		seen[f[0]] = 1;
+		if (widest == nullptr || f[1] > widest[1]) {
+			widest = f;
+		}
+	}
+	seen.assign(portView.rows, 0);
+	const int *p = portView.ints();
+	int maxBandwidth = 0;
+	for (Py_ssize_t i = 0; i < portView.rows; ++i, p += 2) {
+		if (p[0] < 0 || p[0] >= portView.rows || seen[p[0]]) {
+			snprintf(message, sizeof(message), "ports 的 id 应为 0..%zd 且各出现一次，第 %zd 行的 id 为 %d",
+			         portView.rows - 1, i, p[0]);
+			PyErr_SetString(PyExc_ValueError, message);
+			return false;
+		}
+		seen[p[0]] = 1;
+		maxBandwidth = max(maxBandwidth, p[1]);
+	}
+	if (widest != nullptr && (portView.rows == 0 || widest[1] > maxBandwidth)) {
+		snprintf(message, sizeof(message), "流 %d 的带宽 %d 超过了所有端口的带宽", widest[0], widest[1]);
+		PyErr_SetString(PyExc_ValueError, message);
+		return false;
+	}
+	return true;
+}
+
+// 一个数据集的调度和检查输入, 由数组构造一次, 之后每次调度 / 检查从这里复制
+class Dataset {
+public:
+	list<solver::Flow> flows;
+	vector<solver::Port> ports;
+	vector<checker::Flow> checkFlows;
+	vector<checker::Port> checkPorts;
+
+	Dataset(const BufferView &flowView, const BufferView &portView);
+	int schedule(vector<vector<int>> &results, double a, double b, double c, const RuleSet &rules) const;
+	int check(vector<checker::Result> &res, const RuleSet &rules) const;
+};
+
+Dataset::Dataset(const BufferView &flowView, const BufferView &portView) {
+	const int *f = flowView.ints();
+	for (Py_ssize_t i = 0; i < flowView.rows; ++i, f += 4) {
+		flows.emplace_back(f[0], f[1], f[2], f[3]);
+		checkFlows.emplace_back(f[0], f[1], f[2], f[3]);
+	}
+	// 与 solve2 的 main 相同的排序
+	flows.sort([](solver::Flow &first, solver::Flow &second) {
+		if (first.startTime != second.startTime) {
+			return first.startTime < second.startTime;
+		} else if (first.bandwidth != second.bandwidth) {
+			return first.bandwidth < second.bandwidth;
+		} else {
+			return first.sendTime < second.sendTime;
+		}
+	});
+	stable_sort(checkFlows.begin(), checkFlows.end(),
+	            [](const checker::Flow &x, const checker::Flow &y) { return x.begintime < y.begintime; });
+	// 两个核心都把端口在数组中的位置当作端口 id, 按 id 排好 (validDataset 已保证 id 为 0..m-1)
+	vector<const int *> byId(portView.rows);
+	const int *p = portView.ints();
+	for (Py_ssize_t i = 0; i < portView.rows; ++i, p += 2) {
+		byId[p[0]] = p;
+	}
+	for (const int *port: byId) {
+		ports.emplace_back(port[0], port[1]);
+		checkPorts.emplace_back(port[0], port[1]);
+	}
+}
+
+int Dataset::schedule(vector<vector<int>> &results, double a, double b, double c, const RuleSet &rules) const {
+	if (results.size() != flows.size()) {
+		results.assign(flows.size(), vector<int>(3));
+	}
+	return solver::transfer(flows, ports, results, a, b, c, nullptr, rules);
+}
+
+int Dataset::check(vector<checker::Result> &res, const RuleSet &rules) const {
+	vector<checker::Flow> f = checkFlows;
+	vector<checker::Port> p = checkPorts;
+	return checker::algorithm(f, p, res, rules);
+}
+
+static bool parseRules(int which, RuleSet &rules) {
+	if (which != 1 && which != 2) {
+		PyErr_SetString(PyExc_ValueError, "rules 只能是 1 或 2");
+		return false;
+	}
+	rules.queueing = which == 2;
+	return true;
+}
+
+static PyObject *transfer(PyObject *, PyObject *args, PyObject *kwargs) {
+	static const char *keywords[] = {"flows", "ports", "a", "b", "c", "rules", nullptr};
+	PyObject *flowObj, *portObj;
+	double a, b, c = 0;
+	int which = 2;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOdd|di", (char **) keywords, &flowObj, &portObj, &a, &b, &c,
+	                                 &which)) {
+		return nullptr;
+	}
+	RuleSet rules;
+	BufferView flowView(flowObj, 4, 'i', "flows");
+	BufferView portView(portObj, 2, 'i', "ports");
+	if (!parseRules(which, rules) || !flowView.ok || !portView.ok ||
+	    !validDataset(flowView, portView)) {
+		return nullptr;
+	}
+	auto *data = new vector<int>();
+	int ret;
+	Py_BEGIN_ALLOW_THREADS
+	Dataset dataset(flowView, portView);
+	vector<vector<int>> results;
+	ret = dataset.schedule(results, a, b, c, rules);
+	data->reserve(3 * results.size());
+	for (const auto &r: results) {
+		data->insert(data->end(), r.begin(), r.begin() + 3);
+	}
+	Py_END_ALLOW_THREADS
+	PyObject *table = newTable(data, resultColumns);
+	if (table == nullptr) {
+		return nullptr;
+	}
+	return Py_BuildValue("(iN)", ret, table);
+}
+
+static PyObject *score(PyObject *, PyObject *args, PyObject *kwargs) {
+	static const char *keywords[] = {"flows", "ports", "results", "rules", nullptr};
+	PyObject *flowObj, *portObj, *resultObj;
+	int which = 2;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|i", (char **) keywords, &flowObj, &portObj, &resultObj,
+	                                 &which)) {
+		return nullptr;
+	}
+	RuleSet rules;
+	BufferView flowView(flowObj, 4, 'i', "flows");
+	BufferView portView(portObj, 2, 'i', "ports");
+	BufferView resultView(resultObj, 3, 'i', "results");
+	if (!parseRules(which, rules) || !flowView.ok || !portView.ok || !resultView.ok ||
+	    !validDataset(flowView, portView)) {
+		return nullptr;
+	}
+	int ret;
+	Py_BEGIN_ALLOW_THREADS
+	Dataset dataset(flowView, portView);
+	vector<checker::Result> res;
+	const int *r = resultView.ints();
+	for (Py_ssize_t i = 0; i < resultView.rows; ++i, r += 3) {
+		res.emplace_back(r[0], r[1], r[2]);
+	}
+	stable_sort(res.begin(), res.end(),
+	            [](const checker::Result &x, const checker::Result &y) { return x.sendtime < y.sendtime; });
+	ret = dataset.check(res, rules);
+	Py_END_ALLOW_THREADS
+	return PyLong_FromLong(ret);
+}
+
+static PyObject *sweep(PyObject *, PyObject *args, PyObject *kwargs) {
+	static const char *keywords[] = {"flows", "ports", "weights", "c", "rules", "threads", nullptr};
+	PyObject *flowObj, *portObj, *weightObj;
+	double c = 0;
+	int which = 2;
+	int threads = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|dii", (char **) keywords, &flowObj, &portObj, &weightObj, &c,
+	                                 &which, &threads)) {
+		return nullptr;
+	}
+	RuleSet rules;
+	BufferView flowView(flowObj, 4, 'i', "flows");
+	BufferView portView(portObj, 2, 'i', "ports");
+	BufferView weightView(weightObj, 2, 'd', "weights");
+	if (!parseRules(which, rules) || !flowView.ok || !portView.ok || !weightView.ok ||
+	    !validDataset(flowView, portView)) {
+		return nullptr;
+	}
+	int n = (int) weightView.rows;
+	auto *scores = new vector<int>(n);
+	Py_BEGIN_ALLOW_THREADS
+	Dataset dataset(flowView, portView);
+	const double *w = weightView.doubles();
+	if (threads <= 0) {
+		threads = max((int) thread::hardware_concurrency(), 1);
+	}
+	threads = min(threads, max(n, 1));
+	// 每个线程领下一组权重, 结果数组在线程内重复使用
+	atomic<int> next(0);
+	auto run = [&]() {
+		vector<vector<int>> results;
+		vector<checker::Result> res;
+		int k;
+		while ((k = next++) < n) {
+			dataset.schedule(results, w[2 * k], w[2 * k + 1], c, rules);
+			res.clear();
+			for (const auto &r: results) {
+				res.emplace_back(r[0], r[1], r[2]);
+			}
+			(*scores)[k] = dataset.check(res, rules);
+		}
+	};
+	vector<thread> workers;
+	for (int i = 1; i < threads; ++i) {
+		workers.emplace_back(run);
+	}
+	run();
+	for (auto &worker: workers) {
+		worker.join();
+	}
+	Py_END_ALLOW_THREADS
+	return newTable(scores, {});
+}
+
+static PyMethodDef methods[] = {
+		{"load_flows",   loadFlows,                     METH_VARARGS, "load_flows(path) -> Table(id, bandwidth, startTime, sendTime)"},
+		{"load_ports",   loadPorts,                     METH_VARARGS, "load_ports(path) -> Table(id, bandwidth)"},
+		{"load_results", loadResults,                   METH_VARARGS, "load_results(path) -> Table(flow, port, time)"},
+		{"transfer",     (PyCFunction) (void (*)()) transfer, METH_VARARGS | METH_KEYWORDS,
+				"transfer(flows, ports, a, b, c=0, rules=2) -> (estimate, Table(flow, port, time))"},
+		{"score",        (PyCFunction) (void (*)()) score,    METH_VARARGS | METH_KEYWORDS,
+				"score(flows, ports, results, rules=2) -> int"},
+		{"sweep",        (PyCFunction) (void (*)()) sweep,    METH_VARARGS | METH_KEYWORDS,
+				"sweep(flows, ports, weights, c=0, rules=2, threads=0) -> Table of scores"},
+		{nullptr, nullptr, 0, nullptr}
+};
+
+static PyModuleDef module = {PyModuleDef_HEAD_INIT, "zetsim", "solve2 调度核心和 determine_2 检查核心的 Python 接口", -1,
+                             methods, nullptr, nullptr, nullptr, nullptr};
+
+PyMODINIT_FUNC PyInit_zetsim() {
+	TableType.tp_name = "zetsim.Table";
+	TableType.tp_basicsize = sizeof(TableObject);
+	TableType.tp_dealloc = (destructor) tableDealloc;
+	TableType.tp_flags = Py_TPFLAGS_DEFAULT;
+	TableType.tp_doc = "int32 数组, 支持缓冲区协议, np.asarray 不复制";
+	TableType.tp_as_buffer = &tableBuffer;
+	tableSequence.sq_length = (lenfunc) tableLength;
+	TableType.tp_as_sequence = &tableSequence;
+	TableType.tp_getset = tableGetSet;
+	if (PyType_Ready(&TableType) < 0) {
+		return nullptr;
+	}
+	PyObject *m = PyModule_Create(&module);
+	if (m == nullptr) {
+		return nullptr;
+	}
+	Py_INCREF(&TableType);
+	if (PyModule_AddObject(m, "Table", (PyObject *) &TableType) < 0) {
+		Py_DECREF(&TableType);
+		Py_DECREF(m);
+		return nullptr;
+	}
+	return m;
+}
@@ -3,7 +3,14 @@
 #include <vector>
 #include <list>
 #include <queue>
+#include <set>
 #include <climits>
+#include <cstring>
+#include "../common/port_search.h"
+#include "../common/port_index.h"
+#include "../common/batch_pack.h"
+#include "../common/result_ring.h"
+#include "../common/latency.h"
 
 using namespace std;
 
@@ -76,6 +83,17 @@ public:
 	}
 };
 
+// 一起装箱时的缓存区顺序: 带宽降序, 带宽相同时按发送所需时间降序
+class CompareAsBandwidth {
+public:
+	bool operator()(const Flow &flow1, const Flow &flow2) const {
+		if (flow1.bandwidth != flow2.bandwidth) {
+			return flow1.bandwidth > flow2.bandwidth;
+		}
+		return flow1.sendTime > flow2.sendTime;
+	}
+};
+
 class Port {
 public:
 	int id;
@@ -145,28 +163,13 @@ void loadPort(const char *filePath, vector<Port> &posts) {
 	}
 }
 
-// 二分查找 posts 中第一个大于 bandwidth 的索引
-int binary_search(vector<Port> &ports, int value) {
-	int left = 0, right = ports.size() - 1;
-	int ans = -1;
-	while (left <= right) {
-		int mid = (right + left) / 2;
-		if (ports[mid].remainBandwidth >= value) {
-			ans = mid;
-			left = mid + 1;
-		} else {
-			right = mid - 1;
-		}
-	}
-	return ans;
-}
-
-int transfer(list<Flow> flows, vector<Port> ports, vector<vector<int>> &results) {
-	unsigned portNum = ports.size();
+// latency 不为空时记录每个流的延迟 (common/latency.h), 流的下标为结果的顺序; 没有排队区, 离开缓存区即开始发送
+template<class Ports>
+int transferWith(list<Flow> &flows, Ports &ports, int portNum, vector<vector<int>> &results, Packing packing,
+                 LatencyTracker *latency) {
 	int resultPos = 0;
-	// 端口按照剩余带宽大小进行升序排列，并记录最大的剩余带宽，用来提前判断流有没有可以发送的端口
-	sort(ports.begin(), ports.end(), less<>());
-	int maxRemainBandwidth = ports[portNum - 1].remainBandwidth;
+	// 记录最大的剩余带宽，用来提前判断流有没有可以发送的端口
+	int maxRemainBandwidth = ports.maxRemain();
 	// 当前时间
 	int time = 0;
 	// 发送所有的流所用时间
@@ -178,47 +181,91 @@ int transfer(list<Flow> flows, vector<Port> ports, vector<vector<int>> &results)
 	priority_queue<Flow, vector<Flow>, greater<>> min_heap;
 	// 缓存区，按照发送所需时间降序排列
 	priority_queue<Flow, vector<Flow>, CompareAsSendTime> dispatch;
-	while (!flows.empty() || !dispatch.empty()) {
+	// packing 不为 none 时缓存区改为按带宽降序排列, 每个时刻把缓存区中的流一起装箱 (common/batch_pack.h)
+	multiset<Flow, CompareAsBandwidth> packingDispatch;
+	BatchPacker packer;
+	vector<int> bins(portNum);
+	while (!flows.empty() || !dispatch.empty() || !packingDispatch.empty()) {
 		flow = (!flows.empty() ? flows.front() : temp);
 		flowAtPort = (!min_heap.empty() ? min_heap.top() : temp);
 		// 更新端口，查看端口有无已经发送完毕的流，并更新端口剩余带宽、排序、保存最大剩余带宽
 		while (!flowAtPort.isNull() && flowAtPort.endTime == time) {
-			for (auto &port: ports) {
-				if (port.id == flowAtPort.portId) {
-					port.modifyRemain(-flowAtPort.bandwidth);
-					min_heap.pop();
-					sort(ports.begin(), ports.end(), greater<>());
-					maxRemainBandwidth = ports[0].remainBandwidth;
-					flowAtPort = (!min_heap.empty() ? min_heap.top() : temp);
-					break;
-				}
-			}
+			ports.modify(flowAtPort.portId, -flowAtPort.bandwidth);
+			min_heap.pop();
+			ports.commit(flowAtPort.portId);
+			maxRemainBandwidth = ports.maxRemain();
+			flowAtPort = (!min_heap.empty() ? min_heap.top() : temp);
 		}
 		// 查看是否有流进入设备，若有进入放入缓存区堆中
 		while (!flow.isNull() && flow.startTime <= time) {
-			dispatch.push(flow);
+			if (packing != Packing::none) {
+				packingDispatch.insert(flow);
+			} else {
+				dispatch.push(flow);
+			}
 			flows.pop_front();
 			flow = (!flows.empty() ? flows.front() : temp);
 		}
+		// 一起装箱: 带宽不超过最大剩余带宽的流一定放得下, 每次从第一个这样的流开始放
+		if (packing != Packing::none && !packingDispatch.empty() &&
+		    packingDispatch.rbegin()->bandwidth <= maxRemainBandwidth) {
+			for (int id = 0; id < portNum; ++id) {
+				bins[id] = ports.remain(id);
+			}
+			packer.reset(bins);
+			Flow probe;
+			probe.sendTime = INT_MAX;
+			while (true) {
+				probe.bandwidth = packer.largest();
+				auto it = packingDispatch.lower_bound(probe);
+				if (it == packingDispatch.end()) {
+					break;
+				}
+				Flow f = *it;
+				packingDispatch.erase(it);
+				int id = packer.place(f.bandwidth, packing);
+				f.setBeginTime(time);
+				f.setEndTime(time);
+				f.portId = id;
+				results[resultPos][0] = f.id;
+				results[resultPos][1] = id;
+				results[resultPos][2] = time;
+				if (latency != nullptr) {
+					latency->leave(resultPos, id, f.startTime, time);
+					latency->start(resultPos, f.bandwidth, f.startTime, time, f.sendTime);
+				}
+				resultPos++;
+				maxTime = max(maxTime, f.endTime);
+				min_heap.push(f);
+				ports.modify(id, f.bandwidth);
+				ports.commit(id);
+			}
+			maxRemainBandwidth = ports.maxRemain();
+		}
 		// 发送缓存区中的流，选择剩余带宽大于该流的最小端口
-		while (!dispatch.empty()) {
+		while (packing == Packing::none && !dispatch.empty()) {
 			flowAtDispatch = dispatch.top();
 			if (flowAtDispatch.bandwidth <= maxRemainBandwidth) {
-				int i = binary_search(ports, flowAtDispatch.bandwidth);
+				int id = ports.bestFit(flowAtDispatch.bandwidth);
 				flowAtDispatch.setBeginTime(time);
 				flowAtDispatch.setEndTime(time);
-				flowAtDispatch.portId = ports[i].id;
+				flowAtDispatch.portId = id;
 				// fprintf(fpWrite, "%d,%d,%d\n", flowAtDispatch.id, flowAtDispatch.portId, flowAtDispatch.beginTime);
 				// cout << flowAtDispatch.id << "," << flowAtDispatch.portId << "," << flowAtDispatch.beginTime << endl;
 				results[resultPos][0] = flowAtDispatch.id;
 				results[resultPos][1] = flowAtDispatch.portId;
 				results[resultPos][2] = flowAtDispatch.beginTime;
+				if (latency != nullptr) {
+					latency->leave(resultPos, id, flowAtDispatch.startTime, time);
+					latency->start(resultPos, flowAtDispatch.bandwidth, flowAtDispatch.startTime, time,
+					               flowAtDispatch.sendTime);
+				}
 				resultPos++;
 				maxTime = max(maxTime, flowAtDispatch.endTime);
 				min_heap.push(flowAtDispatch);
-				ports[i].modifyRemain(flowAtDispatch.bandwidth);
-				sort(ports.begin(), ports.end(), greater<>());
-				maxRemainBandwidth = ports[0].remainBandwidth;
+				ports.modify(id, flowAtDispatch.bandwidth);
+				ports.commit(id);
+				maxRemainBandwidth = ports.maxRemain();
 				dispatch.pop();
 			} else {
 				break;
@@ -229,6 +276,23 @@ int transfer(list<Flow> flows, vector<Port> ports, vector<vector<int>> &results)
 	return maxTime;
 }
 
+// 端口数量不超过 64 时使用 SIMD 端口选择, 否则使用按容量等级的两级索引 (common/port_index.h), 两者的选择规则相同
+// packing 不为 none 时每个时刻缓存区中的流一起装箱, 见 common/batch_pack.h
+int transfer(list<Flow> flows, vector<Port> ports, vector<vector<int>> &results, Packing packing = Packing::none,
+             LatencyTracker *latency = nullptr) {
+	vector<int> portBandwidths(ports.size());
+	for (size_t i = 0; i < ports.size(); ++i) {
+		portBandwidths[i] = ports[i].bandwidth;
+	}
+	if (PortSearch::fits(portBandwidths)) {
+		// 降序数组里二分找到的是剩余带宽相同的端口中最靠后的一个
+		PortSearch small(portBandwidths, true);
+		return transferWith(flows, small, (int) ports.size(), results, packing, latency);
+	}
+	PortIndex wide(portBandwidths, true);
+	return transferWith(flows, wide, (int) ports.size(), results, packing, latency);
+}
+
 // 写入文件
 void write_file(const char *outFilePath, vector<vector<int>> results, const unsigned long &num) {
 	FILE *fpWrite = fopen(outFilePath, "w");
@@ -238,11 +302,45 @@ void write_file(const char *outFilePath, vector<vector<int>> results, const unsi
 	fclose(fpWrite);
 }
 
-int main() {
+// 写入共享内存环形缓冲区, 读端跟不上时会在这里等待; 读端提前结束 (结果不合法)、长时间不读或写完后一直没有打开时返回 false
+bool write_shm(const string &name, int dataset, vector<vector<int>> &results, const unsigned long &num) {
+	ResultRing *ring = ResultRing::create(name, dataset);
+	if (ring == nullptr) {
+		return false;
+	}
+	bool ok = true;
+	for (size_t i = 0; i < num && ok; ++i) {
+		ok = ring->push(results[i][0], results[i][1], results[i][2]);
+	}
+	ok = ring->finish() && ok;
+	delete ring;
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
 	int dirNum = 0;
 	auto lambda = [](Flow &first, Flow &second) {
 		return first.startTime < second.startTime;
 	};
+	// --shm NAME : 结果不写文件, 逐条写入共享内存环形缓冲区 /NAME.N, 由 determine_1 --shm NAME 读取
+	string shmName;
+	// --pack ffd|bfd : 每个时刻把缓存区中的流一起装箱 (common/batch_pack.h), 不再按发送所需时间逐个发送
+	Packing packing = Packing::none;
+	// --latency : 记录每个流的缓存区等待和完成时间 (common/latency.h), 分位数写入 data/N/latency.csv, 摘要输出到标准错误
+	bool latency = false;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--latency") == 0) {
+			latency = true;
+		}
+	}
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (strcmp(argv[i], "--shm") == 0) {
+			shmName = argv[i + 1];
+		} else if (strcmp(argv[i], "--pack") == 0 && !parsePacking(argv[i + 1], packing)) {
+			fprintf(stderr, "--pack 只能是 ffd、bfd 或 none\n");
+			return 1;
+		}
+	}
 	while (true) {
 		string flowsFilePath;
 		flowsFilePath.append(dataPath).append("/").append(to_string(dirNum)).append("/").append(flowFile);
@@ -267,9 +365,28 @@ int main() {
 		auto flowsNum = flows.size();
 
 		vector<vector<int>> results(flowsNum, vector<int>(3));
-		transfer(flows, ports, results);
+		if (latency) {
+			LatencyTracker tracker((int) ports.size(), flowsNum);
+			transfer(flows, ports, results, packing, &tracker);
+			fprintf(stderr, "第%d号文件 延迟：", dirNum);
+			tracker.summary(stderr);
+			string latencyPath = dataPath + "/" + to_string(dirNum) + "/latency.csv";
+			FILE *out = fopen(latencyPath.c_str(), "w");
+			if (out != nullptr) {
+				tracker.write(out);
+				fclose(out);
+			}
+		} else {
+			transfer(flows, ports, results, packing);
+		}
 
-		write_file(resultsFilePath.c_str(), results, flowsNum);
+		if (!shmName.empty()) {
+			if (!write_shm(shmName, dirNum, results, flowsNum)) {
+				fprintf(stderr, "第%d号文件：结果没有全部写入共享内存结果通道（读端已提前结束、一直没有打开或通道无法创建）\n", dirNum);
+			}
+		} else {
+			write_file(resultsFilePath.c_str(), results, flowsNum);
+		}
 		dirNum++;
 	}
 }
@@ -0,0 +1,170 @@
+#ifndef ZET_2023_BACKLOG_H
+#define ZET_2023_BACKLOG_H
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+// 缓存区溢出时选择排队区: 每个端口记录排队区中流的数量和 带宽 * 发送所需时间 之和 (work),
+// 排队区要在 load = work / 端口带宽 个时刻之后才能排空, 选未满的排队区中 load 最小的一个
+//   流进入排队区时 add, 从排队区取出开始发送时 remove, 都只改一个端口
+//   正在发送的流也算进去时 data/0-9 的总时间反而略差 (宽端口上的流结束得快, 不会一直挡住排队区), 所以只算排队区
+//   当前时刻对所有端口相同, 按 load 排序和按估计的排空时刻排序一样, 不随时间变化
+// 端口不超过 64 个时 load 存在连续数组里, 查询时顺序扫描 (和 port_search.h 一样, 端口少时比堆快)
+// 端口更多时按端口带宽分组, 每组一个按 load 排列的最小堆, 只放排队区未满的端口,
+// 记录每个端口在堆中的位置, 修改时原地上浮 / 下沉, 查询时比较带宽放得下的各组的堆顶
+namespace solver {
+
+class PortBacklog {
+public:
+	static constexpr int scanLimit = 64;
+
+	PortBacklog(const std::vector<int> &portBandwidths, int queueLimit);
+	void add(int id, int bandwidth, int sendTime);
+	void remove(int id, int bandwidth, int sendTime);
+	// 带宽放得下 bandwidth 且排队区未满的端口中 load 最小的一个 (相同时取编号小的), 没有返回 -1
+	int lightest(int bandwidth) const;
+
+private:
+	struct Group {
+		int bandwidth;
+		std::vector<int> heap;
+	};
+
+	std::vector<int> bandwidths;
+	std::vector<long long> works;
+	std::vector<double> loads;
+	std::vector<int> counts;
+	int queueLimit;
+	bool indexed;
+	// 按带宽从大到小的分组, 端口 id -> 所在的组和在堆中的位置 (排队区已满时为 -1)
+	std::vector<Group> groups;
+	std::vector<int> groupOf;
+	std::vector<int> position;
+
+	bool before(int x, int y) const;
+	void swap(std::vector<int> &heap, int i, int j);
+	void siftUp(std::vector<int> &heap, int i);
+	void siftDown(std::vector<int> &heap, int i);
+	void change(int id, long long work, int count);
+};
+
+inline PortBacklog::PortBacklog(const std::vector<int> &portBandwidths, int queueLimit)
+		: bandwidths(portBandwidths), works(portBandwidths.size(), 0), loads(portBandwidths.size(), 0),
+		  counts(portBandwidths.size(), 0), queueLimit(queueLimit), indexed(portBandwidths.size() > scanLimit) {
+	if (!indexed) {
+		return;
+	}
+	std::vector<int> distinct(bandwidths);
+	std::sort(distinct.begin(), distinct.end(), std::greater<>());
+	distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+	for (int bandwidth: distinct) {
+		groups.push_back({bandwidth, {}});
+	}
+	// load 全为 0, 按 id 排列就是合法的堆
+	for (int id = 0; id < (int) bandwidths.size(); ++id) {
+		int g = (int) (std::lower_bound(distinct.begin(), distinct.end(), bandwidths[id], std::greater<>()) -
+		               distinct.begin());
+		groupOf.push_back(g);
+		position.push_back((int) groups[g].heap.size());
+		groups[g].heap.push_back(id);
+	}
+}
+
+inline bool PortBacklog::before(int x, int y) const {
+	return loads[x] != loads[y] ? loads[x] < loads[y] : x < y;
+}
+
+inline void PortBacklog::swap(std::vector<int> &heap, int i, int j) {
+	std::swap(heap[i], heap[j]);
+	position[heap[i]] = i;
+	position[heap[j]] = j;
+}
+
+inline void PortBacklog::siftUp(std::vector<int> &heap, int i) {
+	while (i > 0 && before(heap[i], heap[(i - 1) / 2])) {
+		swap(heap, i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+inline void PortBacklog::siftDown(std::vector<int> &heap, int i) {
+	int n = (int) heap.size();
+	while (true) {
+		int least = i;
+		for (int child = 2 * i + 1; child <= 2 * i + 2 && child < n; ++child) {
+			if (before(heap[child], heap[least])) {
+				least = child;
+			}
+		}
+		if (least == i) {
+			return;
+		}
+		swap(heap, i, least);
+		i = least;
+	}
+}
+
+inline void PortBacklog::change(int id, long long work, int count) {
+	bool wasFull = counts[id] >= queueLimit;
+	works[id] += work;
+	counts[id] += count;
+	loads[id] = (double) works[id] / bandwidths[id];
+	if (!indexed) {
+		return;
+	}
+	bool full = counts[id] >= queueLimit;
+	std::vector<int> &heap = groups[groupOf[id]].heap;
+	if (wasFull && !full) {
+		position[id] = (int) heap.size();
+		heap.push_back(id);
+		siftUp(heap, position[id]);
+	} else if (!wasFull && full) {
+		// 和最后一个交换后删除, 换过来的端口重新调整位置
+		int i = position[id];
+		swap(heap, i, (int) heap.size() - 1);
+		heap.pop_back();
+		position[id] = -1;
+		if (i < (int) heap.size()) {
+			int moved = heap[i];
+			siftUp(heap, i);
+			siftDown(heap, position[moved]);
+		}
+	} else if (!full) {
+		siftUp(heap, position[id]);
+		siftDown(heap, position[id]);
+	}
+}
+
+inline void PortBacklog::add(int id, int bandwidth, int sendTime) {
+	change(id, (long long) bandwidth * sendTime, 1);
+}
+
+inline void PortBacklog::remove(int id, int bandwidth, int sendTime) {
+	change(id, -(long long) bandwidth * sendTime, -1);
+}
+
+inline int PortBacklog::lightest(int bandwidth) const {
+	int found = -1;
+	if (!indexed) {
+		for (int id = 0; id < (int) bandwidths.size(); ++id) {
+			if (bandwidths[id] >= bandwidth && counts[id] < queueLimit && (found < 0 || before(id, found))) {
+				found = id;
+			}
+		}
+		return found;
+	}
+	for (const Group &group: groups) {
+		if (group.bandwidth < bandwidth) {
+			break;
+		}
+		if (!group.heap.empty() && (found < 0 || before(group.heap[0], found))) {
+			found = group.heap[0];
+		}
+	}
+	return found;
+}
+
+}
+
+#endif //ZET_2023_BACKLOG_H
@@ -0,0 +1,198 @@
+#ifndef ZET_2023_DISPATCH_H
+#define ZET_2023_DISPATCH_H
+
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <vector>
+
+// 缓存区: 容量为 20 * 端口数, 端口有几千个时缓存区有几万到几十万个流,
+// 原来的链表按 compose 线性查找插入位置、缓存区溢出时线性扫描找要抛弃的流, 每个流都是 O(缓存区大小)
+// 这里用两棵平衡树, 插入、取第一个、取抛弃键最小的、删除都是 O(log 缓存区大小), 顺序与原来的链表完全相同:
+//   按 compose 升序, compose 相同时后进入的排在前面 (原来用 lower_bound 插到相同的前面)
+//   抛弃时取 sendTime + c * bandwidth 最小的, 相同时取在缓存区中排在前面的 (原来的 min_element)
+// 每个流进出缓存区时两棵树各分配、释放一个结点, 是最热的路径; 结点从缓存区自己的 NodePool 中取,
+// 释放的结点放回空闲链表重复使用, 稳定之后不再调用 operator new, 缓存区销毁时整块释放
+namespace solver {
+
+// 定长结点池: 按块 (每块 1024 个结点) 申请内存, 释放的结点串成空闲链表
+// 结点大小在第一次分配时确定, 大小不同的请求 (std::set 不会有) 直接交给 operator new
+class NodePool {
+public:
+	NodePool() = default;
+	NodePool(const NodePool &) = delete;
+	NodePool &operator=(const NodePool &) = delete;
+
+	void *allocate(size_t bytes);
+	void deallocate(void *p, size_t bytes);
+
+private:
+	static constexpr size_t blockNodes = 1024;
+
+	static size_t round(size_t bytes) {
+		return (bytes + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+	}
+
+	size_t nodeSize = 0;
+	void *freeList = nullptr;
+	std::vector<std::unique_ptr<char[]>> blocks;
+};
+
+inline void *NodePool::allocate(size_t bytes) {
+	if (nodeSize == 0) {
+		nodeSize = round(bytes);
+	}
+	if (round(bytes) != nodeSize) {
+		return ::operator new(bytes);
+	}
+	if (freeList == nullptr) {
+		// new char[] 的内存按 max_align_t 对齐, 结点大小是它的整数倍
+		blocks.emplace_back(new char[nodeSize * blockNodes]);
+		char *block = blocks.back().get();
+		for (size_t i = blockNodes; i-- > 0;) {
+			*(void **) (block + i * nodeSize) = freeList;
+			freeList = block + i * nodeSize;
+		}
+	}
+	void *p = freeList;
+	freeList = *(void **) p;
+	return p;
+}
+
+inline void NodePool::deallocate(void *p, size_t bytes) {
+	if (round(bytes) != nodeSize) {
+		::operator delete(p);
+		return;
+	}
+	*(void **) p = freeList;
+	freeList = p;
+}
+
+// 从 NodePool 取单个结点的分配器, 两棵树共用同一个池 (结点类型相同)
+template<class T>
+class PoolAllocator {
+public:
+	using value_type = T;
+
+	explicit PoolAllocator(NodePool *p) : pool(p) {}
+
+	template<class U>
+	PoolAllocator(const PoolAllocator<U> &other) : pool(other.pool) {}
+
+	T *allocate(size_t n) {
+		return (T *) pool->allocate(n * sizeof(T));
+	}
+
+	void deallocate(T *p, size_t n) {
+		pool->deallocate(p, n * sizeof(T));
+	}
+
+	template<class U>
+	bool operator==(const PoolAllocator<U> &other) const {
+		return pool == other.pool;
+	}
+
+	template<class U>
+	bool operator!=(const PoolAllocator<U> &other) const {
+		return pool != other.pool;
+	}
+
+private:
+	template<class U>
+	friend class PoolAllocator;
+
+	NodePool *pool;
+};
+
+class DispatchBuffer {
+public:
+	struct Entry {
+		double compose;
+		// 进入缓存区的次序取负, compose 相同时后进入的排在前面
+		long long order;
+		// 在 transfer 的流数组中的下标
+		int index;
+		double drop;
+
+		bool operator<(const Entry &other) const {
+			return compose != other.compose ? compose < other.compose : order < other.order;
+		}
+	};
+
+	DispatchBuffer() = default;
+	// 两棵树的分配器指向自己的 pool, 不能复制或移动
+	DispatchBuffer(const DispatchBuffer &) = delete;
+	DispatchBuffer &operator=(const DispatchBuffer &) = delete;
+
+	using iterator = std::set<Entry, std::less<Entry>, PoolAllocator<Entry>>::const_iterator;
+
+	void insert(int index, double compose, double drop);
+	bool empty() const;
+	size_t size() const;
+	const Entry &front() const;
+	// 抛弃键最小的流
+	const Entry &cheapest() const;
+	void erase(const Entry &entry);
+	iterator erase(iterator it);
+	iterator begin() const;
+	iterator end() const;
+
+private:
+	struct ByDrop {
+		bool operator()(const Entry &x, const Entry &y) const {
+			return x.drop != y.drop ? x.drop < y.drop : x < y;
+		}
+	};
+
+	// pool 要在两棵树之前构造、之后销毁
+	NodePool pool;
+	std::set<Entry, std::less<Entry>, PoolAllocator<Entry>> entries{PoolAllocator<Entry>(&pool)};
+	std::set<Entry, ByDrop, PoolAllocator<Entry>> drops{PoolAllocator<Entry>(&pool)};
+	long long counter = 0;
+};
+
+inline void DispatchBuffer::insert(int index, double compose, double drop) {
+	Entry entry{compose, --counter, index, drop};
+	entries.insert(entry);
+	drops.insert(entry);
+}
+
+inline bool DispatchBuffer::empty() const {
+	return entries.empty();
+}
+
+inline size_t DispatchBuffer::size() const {
+	return entries.size();
+}
+
+inline const DispatchBuffer::Entry &DispatchBuffer::front() const {
+	return *entries.begin();
+}
+
+inline const DispatchBuffer::Entry &DispatchBuffer::cheapest() const {
+	return *drops.begin();
+}
+
+inline void DispatchBuffer::erase(const Entry &entry) {
+	// entry 可能就是树中的元素, 先复制一份
+	Entry copy = entry;
+	entries.erase(copy);
+	drops.erase(copy);
+}
+
+inline DispatchBuffer::iterator DispatchBuffer::erase(iterator it) {
+	drops.erase(*it);
+	return entries.erase(it);
+}
+
+inline DispatchBuffer::iterator DispatchBuffer::begin() const {
+	return entries.begin();
+}
+
+inline DispatchBuffer::iterator DispatchBuffer::end() const {
+	return entries.end();
+}
+
+}
+
+#endif //ZET_2023_DISPATCH_H
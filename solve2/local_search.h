@@ -0,0 +1,217 @@
+#ifndef ZET_2023_LOCAL_SEARCH_H
+#define ZET_2023_LOCAL_SEARCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <random>
+#include <thread>
+#include <vector>
+#include "transfer.h"
+#include "../common/rules.h"
+#include "../determine_2/incremental.h"
+
+// 调度结果的局部搜索后处理: 从 transfer 的贪心结果出发随机修改, 用 determine_2 的增量检查器重新计分, 变好就保留
+//   relocate : 把一条结果换到另一个端口
+//   swap : 交换相近两条结果的流, 端口和发送时间不变 (主要用来换掉被丢弃的发送时间长的流)
+//   delay : 把一条结果的发送时间前后移动几个时刻
+// 每次修改只从最早被修改的发送时刻之前的检查点重新模拟, 见 determine_2/incremental.h
+namespace solver {
+
+struct SearchOptions {
+	// 每个数据集的搜索时间 (秒)
+	double seconds = 1;
+	// 线程数, 0 为硬件线程数
+	int threads = 0;
+	unsigned seed = 1;
+	// 得分不超过 target 时提前停止, 0 为不设目标
+	int target = 0;
+};
+
+struct SearchReport {
+	int before = 0;
+	int after = 0;
+	double seconds = 0;
+	long long evaluated = 0;
+	long long accepted = 0;
+};
+
+// 在序号 [lo, hi) 的结果上做局部搜索直到 deadline 或得分不超过 target, flows 按流 id 存放
+template<class R>
+inline void searchRange(checker::BasicIncrementalChecker<R> &scorer, const std::vector<checker::Flow> &flows,
+                        const std::vector<int> &portBandwidths, int lo, int hi,
+                        std::chrono::steady_clock::time_point deadline, int target, std::mt19937 &rng,
+                        SearchReport &report) {
+	// swap 的两条结果最多相隔 WINDOW 条, delay 最多移动 SHIFT 个时刻
+	const int WINDOW = 512;
+	const int SHIFT = 3;
+	const std::vector<checker::Result> &list = scorer.results();
+	std::vector<checker::Edit> edits;
+	int portNum = (int) portBandwidths.size();
+	if (hi - lo < 2) {
+		return;
+	}
+	while (std::chrono::steady_clock::now() < deadline && scorer.score() > target) {
+		for (int round = 0; round < 16; ++round) {
+			int move = (int) (rng() % 3);
+			int i = lo + (int) (rng() % (hi - lo));
+			// 一半的 swap 从被丢弃的结果出发
+			if (move == 1 && rng() % 2 == 0) {
+				for (int tries = 0; tries < 8 && !scorer.dropped(i); ++tries) {
+					i = lo + (int) (rng() % (hi - lo));
+				}
+			}
+			const checker::Result &r = list[i];
+			const checker::Flow &a = flows[r.flowid];
+			edits.clear();
+			if (move == 0) {
+				int port = (int) (rng() % portNum);
+				if (port == r.portid || portBandwidths[port] < a.speed) {
+					continue;
+				}
+				edits.push_back({i, r.flowid, port, r.sendtime});
+			} else if (move == 1) {
+				int j = i + (int) (rng() % (2 * WINDOW + 1)) - WINDOW;
+				j = std::min(std::max(j, lo), hi - 1);
+				const checker::Result &o = list[j];
+				const checker::Flow &b = flows[o.flowid];
+				if (j == i || a.begintime > o.sendtime || b.begintime > r.sendtime ||
+				    a.speed > portBandwidths[o.portid] || b.speed > portBandwidths[r.portid]) {
+					continue;
+				}
+				edits.push_back({i, o.flowid, r.portid, r.sendtime});
+				edits.push_back({j, r.flowid, o.portid, o.sendtime});
+			} else {
+				int shift = (int) (rng() % (2 * SHIFT)) - SHIFT;
+				shift += shift >= 0 ? 1 : 0;
+				int time = r.sendtime + shift;
+				if (time < a.begintime) {
+					continue;
+				}
+				edits.push_back({i, r.flowid, r.portid, time});
+			}
+			++report.evaluated;
+			int score = scorer.evaluate(edits);
+			if (score != 0 && score < scorer.score()) {
+				scorer.apply(edits);
+				++report.accepted;
+			}
+		}
+	}
+}
+
+// 对 transfer 得到的结果做局部搜索, results 替换为找到的最好结果 (按发送时间排列)
+// 多线程时把结果按序号分成互不重叠的几段, 每个线程只修改自己那一段, 每轮结束后把各段的修改按收益从大到小
+// 合并到当前最好的结果上, 合并后仍然变好才保留
+template<class R>
+inline SearchReport localSearchWith(const std::list<Flow> &flowList, const std::vector<Port> &ports,
+                                    std::vector<std::vector<int>> &results, const SearchOptions &options,
+                                    const R &rules) {
+	auto begin = std::chrono::steady_clock::now();
+	auto deadline = begin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(options.seconds));
+	int n = (int) flowList.size();
+	// 流 id 为 0 ~ n-1, 与 determine_2 相同
+	std::vector<checker::Flow> flows(n);
+	for (const Flow &f: flowList) {
+		flows[f.id] = checker::Flow(f.id, f.bandwidth, f.startTime, f.sendTime);
+	}
+	std::vector<checker::Port> checkerPorts;
+	std::vector<int> portBandwidths;
+	for (const Port &port: ports) {
+		checkerPorts.emplace_back(port.id, port.bandwidth);
+		portBandwidths.push_back(port.bandwidth);
+	}
+	std::vector<checker::Result> list;
+	for (const std::vector<int> &r: results) {
+		list.emplace_back(r[0], r[1], r[2]);
+	}
+	checker::BasicIncrementalChecker<R> master(flows, checkerPorts, list, rules);
+	SearchReport report;
+	report.before = report.after = master.score();
+	if (report.before == 0) {
+		return report;
+	}
+	int threads = options.threads > 0 ? options.threads : std::max(1, (int) std::thread::hardware_concurrency());
+	threads = std::min(threads, std::max(1, n / 1024));
+	// 多线程时每轮 0.1 秒左右, 各线程从当前最好的结果重新开始
+	double roundSeconds = threads == 1 ? options.seconds : std::max(0.02, std::min(0.1, options.seconds / 10));
+	std::vector<std::mt19937> rngs;
+	for (int t = 0; t < threads; ++t) {
+		rngs.emplace_back(options.seed + t);
+	}
+	std::vector<SearchReport> reports(threads);
+	std::vector<std::vector<checker::Result>> segments(threads);
+	std::vector<int> scores(threads);
+	std::vector<checker::Edit> edits;
+	while (std::chrono::steady_clock::now() < deadline && master.score() > options.target) {
+		auto roundEnd = std::min(deadline, std::chrono::steady_clock::now() +
+		                                   std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				                                   std::chrono::duration<double>(roundSeconds)));
+		if (threads == 1) {
+			searchRange(master, flows, portBandwidths, 0, n, roundEnd, options.target, rngs[0], reports[0]);
+			continue;
+		}
+		auto work = [&](int t) {
+			int lo = (int) ((long long) n * t / threads);
+			int hi = (int) ((long long) n * (t + 1) / threads);
+			checker::BasicIncrementalChecker<R> scorer = master;
+			searchRange(scorer, flows, portBandwidths, lo, hi, roundEnd, options.target, rngs[t], reports[t]);
+			segments[t].assign(scorer.results().begin() + lo, scorer.results().begin() + hi);
+			scores[t] = scorer.score();
+		};
+		std::vector<std::thread> pool;
+		for (int t = 1; t < threads; ++t) {
+			pool.emplace_back(work, t);
+		}
+		work(0);
+		for (auto &thread: pool) {
+			thread.join();
+		}
+		std::vector<int> order;
+		for (int t = 0; t < threads; ++t) {
+			if (scores[t] < master.score()) {
+				order.push_back(t);
+			}
+		}
+		std::sort(order.begin(), order.end(), [&](int x, int y) { return scores[x] < scores[y]; });
+		for (int t: order) {
+			int lo = (int) ((long long) n * t / threads);
+			edits.clear();
+			for (int i = 0; i < (int) segments[t].size(); ++i) {
+				const checker::Result &a = segments[t][i];
+				const checker::Result &b = master.results()[lo + i];
+				if (a.flowid != b.flowid || a.portid != b.portid || a.sendtime != b.sendtime) {
+					edits.push_back({lo + i, a.flowid, a.portid, a.sendtime});
+				}
+			}
+			int score = master.evaluate(edits);
+			if (score != 0 && score < master.score()) {
+				master.apply(edits);
+			}
+		}
+	}
+	for (const SearchReport &r: reports) {
+		report.evaluated += r.evaluated;
+		report.accepted += r.accepted;
+	}
+	report.after = master.score();
+	report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	std::vector<checker::Result> best = master.sorted();
+	for (int i = 0; i < n; ++i) {
+		results[i] = {best[i].flowid, best[i].portid, best[i].sendtime};
+	}
+	return report;
+}
+
+inline SearchReport localSearch(const std::list<Flow> &flows, const std::vector<Port> &ports,
+                                std::vector<std::vector<int>> &results, const SearchOptions &options,
+                                const RuleSet &rules = RuleSet()) {
+	return withRules(rules, [&](const auto &r) {
+		return localSearchWith(flows, ports, results, options, r);
+	});
+}
+
+}
+
+#endif //ZET_2023_LOCAL_SEARCH_H
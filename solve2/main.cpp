@@ -4,318 +4,145 @@
 #include <list>
 #include <queue>
 #include <climits>
+#include <cstring>
+#include <cstdlib>
+#include <memory>
+#include <cmath>
+#include "transfer.h"
+#include "local_search.h"
+#include "planner.h"
+#include "time_warp.h"
+#include "../common/result_ring.h"
+#include "../common/lower_bound.h"
 
 using namespace std;
+using namespace solver;
 
 string dataPath = "../data";
 string flowFile = "flow.txt";
 string portFile = "port.txt";
 string resultFile = "result.txt";
 
-class Flow {
-public:
-	// startTime : 进入设备时间
-	// sendTime : 发送所需时间
-	// beginTime : 端口发送开始时间
-	int id;
-	int portId;
-	int bandwidth;
-	int startTime;
-	int beginTime;
-	int endTime;
-	int sendTime;
-	double speed;
-	double compose;
-
-	explicit Flow(int id = -1, int bandwidth = 0, int startTime = 0, int sendTime = 0);
-	bool isNull() const;
-	void setBeginTime(int bt);
-	void setEndTime(int bt);
-	bool operator<(const Flow &other) const;
-	bool operator>(const Flow &other) const;
-	bool operator==(const Flow &other) const;
-};
-
-Flow::Flow(int id, int bandwidth, int startTime, int sendTime) {
-	this->id = id;
-	this->portId = -1;
-	this->bandwidth = bandwidth;
-	this->startTime = startTime;
-	this->sendTime = sendTime;
-	this->beginTime = 0;
-	this->endTime = INT_MAX;
-	this->speed = (double) bandwidth / (double) sendTime;
-}
-
-bool Flow::isNull() const {
-	return id == -1;
-}
-
-void Flow::setBeginTime(int bt) {
-	this->beginTime = bt;
-}
-
-void Flow::setEndTime(int bt) {
-	this->endTime = bt + sendTime;
-}
-
-bool Flow::operator<(const Flow &other) const {
-	return this->endTime < other.endTime;
-}
-
-bool Flow::operator>(const Flow &other) const {
-	return this->endTime > other.endTime;
-}
-
-bool Flow::operator==(const Flow &other) const {
-	return this->endTime == other.endTime;
-}
-
-class Port {
-public:
-	int id;
-	int bandwidth;
-	int remainBandwidth;
-
-	Port(int id, int bandwidth);
-	bool modifyRemain(int bw);
-	bool operator<(const Port &other) const;
-	bool operator==(const Port &other) const;
-	bool operator>(const Port &other) const;
-};
-
-Port::Port(int id, int bandwidth) {
-	this->id = id;
-	this->bandwidth = bandwidth;
-	this->remainBandwidth = bandwidth;
-}
-
-bool Port::modifyRemain(int bw) {
-	if (bw > remainBandwidth) {
-		return false;
-	}
-	remainBandwidth -= bw;
-	return true;
-}
-
-bool Port::operator<(const Port &other) const {
-	return this->remainBandwidth < other.remainBandwidth;
-}
-
-bool Port::operator>(const Port &other) const {
-	return this->remainBandwidth > other.remainBandwidth;
-}
-
-bool Port::operator==(const Port &other) const {
-	return this->remainBandwidth == other.remainBandwidth;
-}
-
-// 读取流文件
-void loadFlow(const char *filePath, list<Flow> &flows) {
-	FILE *fpRead = fopen(filePath, "r");
-	if (fpRead == nullptr) {
-		return;
-	}
-	int id;
-	int bandwidth;
-	int startTime;
-	int sendTime;
-	// 忽略第一行
-	fscanf(fpRead, "%*[^\n]%*c");
-	while (fscanf(fpRead, "%d,%d,%d,%d\n", &id, &bandwidth, &startTime, &sendTime) != EOF) {
-		flows.emplace_back(id, bandwidth, startTime, sendTime);
+int main(int argc, char *argv[]) {
+	int dirNum = 0;
+	// --timeline[=json|bin|both] : 记录端口占用时间线, 写入 data/N/timeline.json 和 data/N/timeline.bin
+	bool timelineJson = false;
+	bool timelineBin = false;
+	// --stdout N [--binary] : 只计算第 N 个数据集, 结果按发送时间顺序写到标准输出, 用于 ./solve2 --stdout N | ./determine_2 --stdin ../data/N
+	bool toStdout = false;
+	bool binary = false;
+	// --shm NAME : 结果不写文件, 逐条写入共享内存环形缓冲区 /NAME.N, 由 determine_2 --shm NAME 读取
+	string shmName;
+	// --optimize SECONDS [--threads N] : 在贪心结果上做 SECONDS 秒局部搜索 (每个数据集), 收益输出到标准错误
+	SearchOptions search;
+	search.seconds = 0;
+	// --gap EPS : 得分与下界 (common/lower_bound.h) 的相对差距不超过 EPS 时提前停止, 不再尝试后面的权重, 局部搜索也停止
+	double gap = -1;
+	// --plan : 再用离线前瞻规划 (planner.h) 算一次, 和贪心结果比较取较好的, 两者的估计总时间输出到标准错误
+	bool planning = false;
+	// --pack ffd|bfd : 每个时刻把缓存区中的流一起装箱 (common/batch_pack.h), 不再按优先级逐个发送
+	Packing packing = Packing::none;
+	// --warp THREADS [--windows K] [--warmup TICKS] : 实验性的乐观并行模拟 (time_warp.h), 同时串行模拟一次比较,
+	//     加速比和回滚率输出到标准错误; 相同时的端口选择规则与 transfer 不同, 不能和 --pack / --timeline 同时使用
+	WarpOptions warp;
+	bool warping = false;
+	// --latency : 记录每个流的缓存区等待、排队区等待和完成时间 (common/latency.h), 按全部、端口、带宽等级的分位数写入
+	//     data/N/latency.csv, 摘要输出到标准错误; 统计的是两组权重中被采用的贪心调度, 不包括 --plan 和 --optimize 的修改
+	bool latency = false;
+	// --objective makespan|tail|weighted [--aging X,Y,...] : 调度目标, 默认 makespan (比赛的计分)
+	//     tail 为 p99 等待时间, weighted 为按带宽加权的平均完成时间, 缓存区排序键和老化系数见 transfer.h 的 BufferKey
+	//     每个候选 (权重 x 老化系数) 调度一次, 取目标最小的 (相同时取总时间小的), 各候选的总时间和两种延迟目标输出到标准错误
+	Objective objective = Objective::makespan;
+	vector<double> agings;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--timeline") == 0 || strcmp(argv[i], "--timeline=both") == 0) {
+			timelineJson = timelineBin = true;
+		} else if (strcmp(argv[i], "--timeline=json") == 0) {
+			timelineJson = true;
+		} else if (strcmp(argv[i], "--timeline=bin") == 0) {
+			timelineBin = true;
+		} else if (strcmp(argv[i], "--stdout") == 0 && i + 1 < argc) {
+			toStdout = true;
+			dirNum = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--binary") == 0) {
+			binary = true;
+		} else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+			shmName = argv[++i];
+		} else if (strcmp(argv[i], "--optimize") == 0 && i + 1 < argc) {
+			search.seconds = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			search.threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--gap") == 0 && i + 1 < argc) {
+			gap = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--plan") == 0) {
+			planning = true;
+		} else if (strcmp(argv[i], "--warp") == 0 && i + 1 < argc) {
+			warping = true;
+			warp.threads = atoi(argv[++i]);
+			warp.verify = true;
+		} else if (strcmp(argv[i], "--windows") == 0 && i + 1 < argc) {
+			warp.windows = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+			warp.warmup = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--latency") == 0) {
+			latency = true;
+		} else if (strcmp(argv[i], "--objective") == 0 && i + 1 < argc) {
+			if (!parseObjective(argv[++i], objective)) {
+				fprintf(stderr, "--objective 只能是 makespan、tail 或 weighted\n");
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--aging") == 0 && i + 1 < argc) {
+			for (char *p = argv[++i]; *p != '\0'; p += (*p == ',')) {
+				char *end;
+				agings.push_back(strtod(p, &end));
+				if (end == p || (*end != ',' && *end != '\0')) {
+					fprintf(stderr, "--aging 应为逗号分隔的数，如 0,10,20\n");
+					return 1;
+				}
+				p = end;
+			}
+		} else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc) {
+			if (!parsePacking(argv[++i], packing)) {
+				fprintf(stderr, "--pack 只能是 ffd、bfd 或 none\n");
+				return 1;
+			}
+		}
 	}
-}
-
-// 读取端口文件
-void loadPort(const char *filePath, vector<Port> &posts) {
-	FILE *fpRead = fopen(filePath, "r");
-	if (fpRead == nullptr) {
-		return;
+	if (warping && (packing != Packing::none || timelineJson || timelineBin)) {
+		fprintf(stderr, "--warp 不能和 --pack、--timeline 同时使用\n");
+		return 1;
 	}
-	int id;
-	int bandwidth;
-	// 忽略第一行
-	fscanf(fpRead, "%*[^\n]%*c");
-	while (fscanf(fpRead, "%d,%d\n", &id, &bandwidth) != EOF) {
-		posts.emplace_back(id, bandwidth);
+	// --gap 比较的是总时间和下界, 延迟目标下按它提前停止会跳过还没试的候选
+	if (objective != Objective::makespan && (warping || planning || search.seconds > 0 || gap >= 0)) {
+		fprintf(stderr, "--objective tail / weighted 不能和 --warp、--plan、--optimize、--gap 同时使用\n");
+		return 1;
 	}
-}
-
-// 二分查找 posts 中第一个大于 bandwidth 的索引
-int binary_search(vector<Port> &posts, int bandwidth) {
-	int n = posts.size();
-	int left = 0, right = n - 1;
-	int res = -1;
-	while (left <= right) {
-		int mid = left + (right - left) / 2;
-		if (posts[mid].remainBandwidth >= bandwidth) {
-			res = mid;
-			right = mid - 1;
+	// 候选: (a, b) 为 compose 的权重, weighted 不用这两个权重
+	struct Candidate {
+		double a;
+		double b;
+		BufferKey key;
+	};
+	vector<Candidate> candidates;
+	if (agings.empty()) {
+		// 默认的老化系数: data/0-9 上 tail 在 10 ~ 30 附近 p99 等待最小, weighted 的键小得多, 老化只会变差
+		if (objective == Objective::tail) {
+			agings = {0, 3, 10, 20, 30};
+		} else if (objective == Objective::weighted) {
+			agings = {0, 0.01};
 		} else {
-			left = mid + 1;
+			agings = {0};
 		}
 	}
-	return res;
-}
-
-int transfer(list<Flow> flows, vector<Port> ports, vector<vector<int>> &results, const double &a, const double &b) {
-	// FILE *fpWrite = fopen(resultsFile.c_str(), "w");
-	unsigned portNum = ports.size();
-	vector<int> portBandwidths(portNum);
-	for (int i = 0; i < portNum; ++i) {
-		portBandwidths[i] = ports[i].bandwidth;
-	}
-	// 端口按照剩余带宽升序排列
-	sort(ports.begin(), ports.end(), less<>());
-	// 记录最大剩余带宽
-	int maxRemainBandwidth = ports[portNum - 1].remainBandwidth;
-	int time = 0;
-	// 抛弃流罚时
-	int over = 0;
-	int resultPos = 0;
-	Flow temp;
-	Flow flow, flowAtPort, flowAtDispatch;
-	// 所以端口共用的堆，记录端口正在发送的流
-	priority_queue<Flow, vector<Flow>, greater<>> min_heap;
-	// 缓存区
-	list<Flow> dispatch;
-	// 端口排队去
-	vector<list<Flow>> portQueues(portNum);
-	// 缓存区数量限制
-	unsigned maxDispatchFlow = 20 * portNum;
-	while (!flows.empty() || !dispatch.empty() || !min_heap.empty()) {
-		flow = (!flows.empty() ? flows.front() : temp);
-		flow.compose = (double) flow.sendTime + a * (double) flow.bandwidth + b * flow.speed;
-		flowAtPort = (!min_heap.empty() ? min_heap.top() : temp);
-		while (!flowAtPort.isNull() && flowAtPort.endTime == time) {
-			// 弹出已经发送完毕的流，修改端口剩余带宽，检查排队区是否有流要发送
-			for (int i = 0; i < portNum; ++i) {
-				if (ports[i].id == flowAtPort.portId) {
-					ports[i].modifyRemain(-flowAtPort.bandwidth);
-					min_heap.pop();
-					while (!portQueues[ports[i].id].empty() &&
-					       portQueues[ports[i].id].front().bandwidth <= ports[i].remainBandwidth) {
-						Flow flowAtPortQueue = portQueues[ports[i].id].front();
-						flowAtPortQueue.setBeginTime(time);
-						flowAtPortQueue.setEndTime(time);
-						min_heap.push(flowAtPortQueue);
-						ports[i].modifyRemain(flowAtPortQueue.bandwidth);
-						portQueues[ports[i].id].pop_front();
-					}
-					sort(ports.begin(), ports.end(), less<>());
-					maxRemainBandwidth = ports[portNum - 1].remainBandwidth;
-					flowAtPort = (!min_heap.empty() ? min_heap.top() : temp);
-					break;
-				}
-			}
-		}
-		while (!flow.isNull() && flow.startTime == time) {
-			// 流内的数据不能直接发送到端口，只能通过排队区和缓存区发送到端口
-			// (2.3, 7.9) + (0.8, 0.0) --> 50.52
-			dispatch.insert(
-					std::lower_bound(dispatch.begin(), dispatch.end(), flow, [](const Flow &f1, const Flow &f2) {
-						return f1.compose < f2.compose;
-					}), flow);
-			flowAtDispatch = dispatch.front();
-			if (dispatch.size() > maxDispatchFlow) {
-				// 缓存区已满, 想要把流放入端口排队区, 取流数量最小的排队区
-				// 优化思路: 如果排队区已满则抛弃 sendTime 最小的, 如果未满, 将带宽最小的放入排队区
-				// 优化后 50.35 --> 50.35(a = 0.1) 50.47(a = 0.8)
-				int portPos = 0;
-				for (int j = 0; j < portNum; ++j) {
-					if (portBandwidths[j] >= flowAtDispatch.bandwidth) {
-						if (portBandwidths[portPos] < flowAtDispatch.bandwidth) {
-							portPos = j;
-						} else {
-							portPos = (portQueues[portPos].size() > portQueues[j].size() ? j : portPos);
-						}
-					}
-				}
-				if (portQueues[portPos].size() != 30) {
-					flowAtDispatch.portId = portPos;
-					portQueues[portPos].push_back(flowAtDispatch);
-					// fprintf(fpWrite, "%d,%d,%d\n", flowAtDispatch.id, portPos, time);
-					// cout << flowAtDispatch.id << "," << portPos << "," << time << endl;
-					results[resultPos][0] = flowAtDispatch.id;
-					results[resultPos][1] = flowAtDispatch.portId;
-					results[resultPos][2] = time;
-					++resultPos;
-					dispatch.pop_front();
-				} else {
-					// 缓存区和排队区都超限，选取发送时间最小的抛弃
-					auto f = min_element(dispatch.begin(), dispatch.end(), [](Flow &flow1, Flow &flow2) {
-						return flow1.sendTime < flow2.sendTime;
-					});
-					portPos = 0;
-					for (int j = 0; j < portNum; ++j) {
-						if (portBandwidths[j] >= f->bandwidth) {
-							if (portBandwidths[portPos] < f->bandwidth) {
-								portPos = j;
-							} else {
-								portPos = (portQueues[portPos].size() > portQueues[j].size() ? j : portPos);
-							}
-						}
-					}
-					f->portId = portPos;
-					if (portQueues[portPos].size() != 30) {
-						portQueues[portPos].push_back(*f);
-					} else {
-						over += (2 * f->sendTime);
-					}
-					// fprintf(fpWrite, "%d,%d,%d\n", f->id, portPos, time);
-					// cout << f->id << "," << portPos << "," << f->sendTime << endl;
-					results[resultPos][0] = f->id;
-					results[resultPos][1] = portPos;
-					results[resultPos][2] = time;
-					++resultPos;
-					dispatch.erase(f++);
-				}
-			}
-			flows.pop_front();
-			flow = (!flows.empty() ? flows.front() : temp);
-			flow.compose = (double) flow.sendTime + a * (double) flow.bandwidth + b * flow.speed;
+	for (double aging: agings) {
+		if (objective == Objective::weighted) {
+			candidates.push_back({0, 0, {objective, aging}});
+			continue;
 		}
-		while (!dispatch.empty()) {
-			// 检查端口是否有空闲带宽，并发送
-			flowAtDispatch = dispatch.front();
-			if (flowAtDispatch.bandwidth <= maxRemainBandwidth) {
-				int i = binary_search(ports, flowAtDispatch.bandwidth);
-				flowAtDispatch.setBeginTime(time);
-				flowAtDispatch.setEndTime(time);
-				flowAtDispatch.portId = ports[i].id;
-				// fprintf(fpWrite, "%d,%d,%d\n", flowAtDispatch.id, flowAtDispatch.portId, flowAtDispatch.beginTime);
-				// cout << flowAtDispatch.id << "," << flowAtDispatch.portId << "," << flowAtDispatch.beginTime << endl;
-				results[resultPos][0] = flowAtDispatch.id;
-				results[resultPos][1] = flowAtDispatch.portId;
-				results[resultPos][2] = flowAtDispatch.beginTime;
-				++resultPos;
-				min_heap.push(flowAtDispatch);
-				ports[i].modifyRemain(flowAtDispatch.bandwidth);
-				sort(ports.begin(), ports.end(), less<>());
-				maxRemainBandwidth = ports[portNum - 1].remainBandwidth;
-				dispatch.pop_front();
-			} else {
-				break;
-			}
-		}
-		++time;
-	}
-	// fclose(fpWrite);
-	return time + over;
-}
-
-// 写入文件
-void write_file(const char *outFilePath, vector<vector<int>> &results, const unsigned long &num) {
-	FILE *fpWrite = fopen(outFilePath, "w");
-	for (int i = 0; i < num; ++i) {
-		fprintf(fpWrite, "%d,%d,%d\n", results[i][0], results[i][1], results[i][2]);
+		// 优化思路跑两次，每次用不同的权重，取最好的那一次，(2.3, -7.9) + (0.8, 0.0) --> 50.52
+		candidates.push_back({2.3, -7.9, {objective, aging}});
+		candidates.push_back({0.8, 0.0, {objective, aging}});
 	}
-	fclose(fpWrite);
-}
-
-int main() {
-	int dirNum = 0;
 	auto lambda = [](Flow &first, Flow &second) {
 		if (first.startTime != second.startTime) {
 			return first.startTime < second.startTime;
@@ -345,25 +172,133 @@ int main() {
 		flows.sort(lambda);
 
 		auto flowsNum = flows.size();
-		// 优化思路跑两次，每次用不同的权重，取最好的那一次，(2.3, -7.9) + (0.8, 0.0) --> 50.52
 		vector<vector<int>> temp(flowsNum, vector<int>(3));
 		vector<vector<int>> results;
 		int ret = INT_MAX;
 		int tempRet;
-		double a = 2.3;
-		double b = -7.9;
-		tempRet = transfer(flows, ports, temp, a, b);
-		if (tempRet < ret) {
-			ret = tempRet;
-			results = temp;
+		// 每组权重的时间线先写到临时文件, 最后只保留被采用的那一组
+		string timelinePath;
+		timelinePath.append(dataPath).append("/").append(to_string(dirNum)).append("/timeline");
+		vector<int> portBandwidths;
+		for (auto &port: ports) {
+			portBandwidths.push_back(port.bandwidth);
+		}
+		double bound = 0;
+		if (gap >= 0) {
+			vector<BoundFlow> shapes;
+			for (const Flow &flow: flows) {
+				shapes.push_back({flow.bandwidth, flow.startTime, flow.sendTime});
+			}
+			bound = lowerBound(shapes, portBandwidths).value();
+			search.target = gap < 1 ? (int) min(bound / (1 - gap), (double) INT_MAX) : INT_MAX;
 		}
-		a = 0.8, b = 0.0;
-		tempRet = transfer(flows, ports, temp, a, b);
-		if (tempRet < ret) {
-			ret = tempRet;
-			results = temp;
+		int bestRun = 0;
+		unique_ptr<LatencyTracker> bestLatency;
+		double bestValue = HUGE_VAL;
+		int runs = (int) candidates.size();
+		for (int run = 0; run < runs && (gap < 0 || boundGap(ret, bound) > gap); ++run) {
+			double a = candidates[run].a;
+			double b = candidates[run].b;
+			const BufferKey &key = candidates[run].key;
+			unique_ptr<LatencyTracker> tracker;
+			if (latency || objective != Objective::makespan) {
+				tracker.reset(new LatencyTracker((int) ports.size(), flowsNum));
+			}
+			if (warping) {
+				WarpReport report = warpTransfer(flows, ports, temp, a, b, 0, RuleSet(), warp);
+				tempRet = report.score;
+				fprintf(stderr,
+				        "第%d号文件 权重(%.1f, %.1f)：得分 %d，%d 个窗口回滚 %d 个（%.1f%%），重新模拟 %.1f%% 的时刻，"
+				        "推测 %.2f 秒 + 提交 %.2f 秒，实际 %.2f 秒，串行 %.2f 秒，%d 线程估计 %.2f 秒（加速 %.2f），"
+				        "结果与串行%s\n", dirNum, a, b, report.score, report.windows, report.rollbacks,
+				        report.windows > 1 ? 100.0 * report.rollbacks / (report.windows - 1) : 0.0,
+				        report.ticks > 0 ? 100.0 * (double) report.replayed / (double) report.ticks : 0.0,
+				        report.speculated, report.committed, report.wall, report.serial, warp.threads,
+				        report.modeled, report.modeled > 0 ? report.serial / report.modeled : 0.0,
+				        report.identical ? "相同" : "不同");
+			} else if (timelineJson || timelineBin) {
+				string suffix = "." + to_string(run);
+				TimelineRecorder timeline(timelineJson ? timelinePath + ".json" + suffix : "",
+				                          timelineBin ? timelinePath + ".bin" + suffix : "", portBandwidths);
+				tempRet = transfer(flows, ports, temp, a, b, 0, &timeline, RuleSet(), packing, tracker.get(), key);
+			} else {
+				tempRet = transfer(flows, ports, temp, a, b, 0, nullptr, RuleSet(), packing, tracker.get(), key);
+			}
+			double value = tempRet;
+			if (objective != Objective::makespan) {
+				int tail = tracker->overall(LatencyTracker::wait).percentile(0.99);
+				double weighted = tracker->weightedCompletion();
+				value = objective == Objective::tail ? tail : weighted;
+				fprintf(stderr, "第%d号文件 权重(%.1f, %.1f) 老化 %g：总时间 %d，p99 等待 %d，加权完成时间 %.2f，丢弃 %lld\n",
+				        dirNum, a, b, key.aging, tempRet, tail, weighted, tracker->dropped());
+			}
+			if (value < bestValue || (value == bestValue && tempRet < ret)) {
+				bestValue = value;
+				ret = tempRet;
+				results = temp;
+				bestRun = run;
+				bestLatency = move(tracker);
+			}
+		}
+		if (timelineJson || timelineBin) {
+			for (int run = 0; run < runs; ++run) {
+				for (const char *ext: {".json", ".bin"}) {
+					string path = timelinePath + ext + "." + to_string(run);
+					if (run == bestRun) {
+						rename(path.c_str(), (timelinePath + ext).c_str());
+					} else {
+						remove(path.c_str());
+					}
+				}
+			}
+		}
+		if (bestLatency != nullptr) {
+			fprintf(stderr, "第%d号文件 延迟：", dirNum);
+			bestLatency->summary(stderr);
+			if (!toStdout) {
+				string latencyPath = dataPath + "/" + to_string(dirNum) + "/latency.csv";
+				FILE *out = fopen(latencyPath.c_str(), "w");
+				if (out != nullptr) {
+					bestLatency->write(out);
+					fclose(out);
+				}
+			}
+		}
+		if (planning && (gap < 0 || boundGap(ret, bound) > gap)) {
+			vector<vector<int>> planned;
+			PlanReport plan = solver::plan(flows, ports, planned);
+			fprintf(stderr, "第%d号文件：规划 %d（保留 %d，丢弃端口 %d，丢弃 %d），贪心 %d\n", dirNum, plan.score,
+			        plan.planned, plan.sunk, plan.dropped, ret);
+			if (plan.score >= 0 && plan.score < ret) {
+				ret = plan.score;
+				results = planned;
+			}
+		}
+		// transfer 返回的是它自己估计的总时间, 局部搜索之后为检查器的结果
+		int score = ret;
+		if (search.seconds > 0) {
+			SearchReport report = localSearch(flows, ports, results, search);
+			score = report.after;
+			fprintf(stderr, "第%d号文件：%d -> %d，提升 %d（%.1f/秒），尝试 %lld 次，接受 %lld 次\n", dirNum, report.before,
+			        report.after, report.before - report.after,
+			        report.seconds > 0 ? (report.before - report.after) / report.seconds : 0.0, report.evaluated,
+			        report.accepted);
+		}
+		if (gap >= 0) {
+			fprintf(stderr, "第%d号文件：得分 %d，下界 %.0f，差距 %.2f%%\n", dirNum, score, bound,
+			        boundGap(score, bound) * 100);
+		}
+		if (toStdout) {
+			write_stream(stdout, results, flowsNum, binary);
+			return 0;
+		}
+		if (!shmName.empty()) {
+			if (!write_shm(shmName, dirNum, results, flowsNum)) {
+				fprintf(stderr, "第%d号文件：结果没有全部写入共享内存结果通道（读端已提前结束、一直没有打开或通道无法创建）\n", dirNum);
+			}
+		} else {
+			write_file(resultsFilePath.c_str(), results, flowsNum);
 		}
-		write_file(resultsFilePath.c_str(), results, flowsNum);
 
 		dirNum++;
 	}
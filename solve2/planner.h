@@ -0,0 +1,361 @@
+#ifndef ZET_2023_PLANNER_H
+#define ZET_2023_PLANNER_H
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <list>
+#include <queue>
+#include <vector>
+#include "transfer.h"
+#include "../common/rules.h"
+
+// 离线前瞻规划: 检查器只要求发送时间不早于进入设备时间, 全部流的到达事先都知道,
+// 所以不必像 transfer 那样逐个时刻贪心, 可以先把要保留的流在整条时间轴上排好
+//   端口分成两类: 带宽最小的 (放得下所有流的) 一个端口作为丢弃端口, 其余为规划端口
+//   规划端口: 每个端口一条 时间 x 带宽 的占用轮廓 (skyline), 按优先级 (带宽小的先, 同带宽发送时间长的先) 逐个流放到
+//       所有规划端口中最早能放下它的时刻, 到那个时刻才发送, 发送时端口排队区为空且带宽足够, 一定立即开始发送
+//       发送前流一直在缓存区里, 任何时刻等待中的流不超过 bufferFactor * 端口数, 超出或者收益不够 (推迟的总时间
+//       不小于丢弃的罚时) 就不保留
+//   丢弃端口: 其余的流都在进入设备的时刻发到这里, 同一时刻按发送所需时间从大到小发送,
+//       先来的放进排队区或直接发送, 排队区满了之后的被丢弃, 这个端口按检查器的规则逐个事件模拟
+// 占用轮廓和缓存区都用时间轴上的线段树 (区间加、区间最大值), 时间轴只覆盖到最晚进入时间之后几个最长发送时间,
+// 每个流 O(端口数 * log T), 排序 O(n log n)
+namespace solver {
+
+// 时间轴 [0, size) 上的线段树: 区间加, 区间最大值, 区间最小值, 查找区间中第一个 / 最后一个大于 limit 的位置
+class Skyline {
+public:
+	explicit Skyline(int horizon) {
+		size = 1;
+		while (size < horizon) {
+			size <<= 1;
+		}
+		high.assign(2 * size, 0);
+		low.assign(2 * size, 0);
+		lazy.assign(2 * size, 0);
+	}
+
+	void add(int lo, int hi, int value) {
+		if (lo < hi) {
+			add(1, 0, size, lo, hi, value);
+		}
+	}
+
+	int max(int lo, int hi) const {
+		return lo < hi ? max(1, 0, size, lo, hi) : INT_MIN;
+	}
+
+	int min(int lo, int hi) const {
+		return lo < hi ? min(1, 0, size, lo, hi) : INT_MAX;
+	}
+
+	int lastAbove(int lo, int hi, int limit) const {
+		return lo < hi ? lastAbove(1, 0, size, lo, hi, limit) : -1;
+	}
+
+	int firstAbove(int lo, int hi, int limit) const {
+		return lo < hi ? firstAbove(1, 0, size, lo, hi, limit) : -1;
+	}
+
+	// [lo, end) 中最早的 s, 使 [s, s + len) 内的值都不超过 limit, 没有返回 -1
+	int earliest(int lo, int len, int limit, int end) const {
+		end = std::min(end, size);
+		if (lo + len > end || min(lo, end) > limit) {
+			return -1;
+		}
+		for (int s = lo; s + len <= end;) {
+			int bad = lastAbove(s, s + len, limit);
+			if (bad < 0) {
+				return s;
+			}
+			s = bad + 1;
+		}
+		return -1;
+	}
+
+private:
+	int size;
+	std::vector<int> high;
+	std::vector<int> low;
+	std::vector<int> lazy;
+
+	void add(int node, int l, int r, int lo, int hi, int value) {
+		if (hi <= l || r <= lo) {
+			return;
+		}
+		if (lo <= l && r <= hi) {
+			high[node] += value;
+			low[node] += value;
+			lazy[node] += value;
+			return;
+		}
+		int m = (l + r) / 2;
+		add(2 * node, l, m, lo, hi, value);
+		add(2 * node + 1, m, r, lo, hi, value);
+		high[node] = std::max(high[2 * node], high[2 * node + 1]) + lazy[node];
+		low[node] = std::min(low[2 * node], low[2 * node + 1]) + lazy[node];
+	}
+
+	int max(int node, int l, int r, int lo, int hi) const {
+		if (hi <= l || r <= lo) {
+			return INT_MIN;
+		}
+		if (lo <= l && r <= hi) {
+			return high[node];
+		}
+		int m = (l + r) / 2;
+		return std::max(max(2 * node, l, m, lo, hi), max(2 * node + 1, m, r, lo, hi)) + lazy[node];
+	}
+
+	int min(int node, int l, int r, int lo, int hi) const {
+		if (hi <= l || r <= lo) {
+			return INT_MAX;
+		}
+		if (lo <= l && r <= hi) {
+			return low[node];
+		}
+		int m = (l + r) / 2;
+		return std::min(min(2 * node, l, m, lo, hi), min(2 * node + 1, m, r, lo, hi)) + lazy[node];
+	}
+
+	// limit 减去祖先节点的 lazy 之后向下找
+	int lastAbove(int node, int l, int r, int lo, int hi, int limit) const {
+		if (hi <= l || r <= lo || high[node] <= limit) {
+			return -1;
+		}
+		if (r - l == 1) {
+			return l;
+		}
+		int m = (l + r) / 2;
+		int found = lastAbove(2 * node + 1, m, r, lo, hi, limit - lazy[node]);
+		return found >= 0 ? found : lastAbove(2 * node, l, m, lo, hi, limit - lazy[node]);
+	}
+
+	int firstAbove(int node, int l, int r, int lo, int hi, int limit) const {
+		if (hi <= l || r <= lo || high[node] <= limit) {
+			return -1;
+		}
+		if (r - l == 1) {
+			return l;
+		}
+		int m = (l + r) / 2;
+		int found = firstAbove(2 * node, l, m, lo, hi, limit - lazy[node]);
+		return found >= 0 ? found : firstAbove(2 * node + 1, m, r, lo, hi, limit - lazy[node]);
+	}
+};
+
+struct PlanReport {
+	// 规划的总时间 (与检查器相同的算法估计), 以及保留在规划端口、丢弃端口上的流数和被丢弃的流数
+	int score = 0;
+	int planned = 0;
+	int sunk = 0;
+	int dropped = 0;
+};
+
+// 规划结果写入 results (按发送时间排列), 只适用于有排队区上限的规则, 否则返回的 score 为 -1
+template<class R>
+inline PlanReport planWith(const std::list<Flow> &flowList, const std::vector<Port> &ports,
+                           std::vector<std::vector<int>> &results, const R &rules) {
+	PlanReport report;
+	report.score = -1;
+	// 只用到 id、带宽、进入时间和发送所需时间, 拷成紧凑的数组
+	struct Shape {
+		int id;
+		int bandwidth;
+		int startTime;
+		int sendTime;
+	};
+	std::vector<Shape> flows;
+	flows.reserve(flowList.size());
+	for (const Flow &f: flowList) {
+		flows.push_back({f.id, f.bandwidth, f.startTime, f.sendTime});
+	}
+	int n = (int) flows.size();
+	int portNum = (int) ports.size();
+	if (!R::queueing || n == 0 || portNum < 2) {
+		return report;
+	}
+	int widest = 0;
+	int last = 0;
+	int longest = 1;
+	for (const Shape &f: flows) {
+		widest = std::max(widest, f.bandwidth);
+		last = std::max(last, f.startTime);
+		longest = std::max(longest, f.sendTime);
+	}
+	// 丢弃端口: 放得下所有流的端口中带宽最小的一个
+	int sink = -1;
+	for (int p = 0; p < portNum; ++p) {
+		if (ports[p].bandwidth >= widest && (sink < 0 || ports[p].bandwidth < ports[sink].bandwidth)) {
+			sink = p;
+		}
+	}
+	if (sink < 0) {
+		return report;
+	}
+	int horizon = last + 4 * longest + 2;
+	std::vector<Skyline> skylines;
+	for (int p = 0; p < portNum; ++p) {
+		skylines.emplace_back(p == sink ? 1 : horizon);
+	}
+	Skyline waiting(horizon);
+	int bufferLimit = rules.bufferFactor * portNum;
+
+	// entries: (发送时间, 同一时刻内的顺序, 流下标, 端口)
+	struct Entry {
+		int time;
+		int order;
+		int flow;
+		int port;
+	};
+	std::vector<Entry> entries;
+	entries.reserve(n);
+	std::vector<char> kept(n, 0);
+	// 排序键和下标放在一起排序, 不在比较时去访问 flows (千万级的流时差别很大)
+	struct Key {
+		int first;
+		int second;
+		int third;
+		int flow;
+
+		bool operator<(const Key &other) const {
+			if (first != other.first) {
+				return first < other.first;
+			}
+			if (second != other.second) {
+				return second < other.second;
+			}
+			return third < other.third;
+		}
+	};
+	std::vector<Key> order(n);
+	for (int i = 0; i < n; ++i) {
+		order[i] = {flows[i].bandwidth, -flows[i].sendTime, flows[i].startTime, i};
+	}
+	std::sort(order.begin(), order.end());
+	int maxEnd = 0;
+	for (const Key &key: order) {
+		int i = key.flow;
+		const Shape &f = flows[i];
+		int len = std::max(f.sendTime, 1);
+		// 推迟的总时间要小于丢弃的罚时: 结束时间不超过 maxEnd + penalty * need - 1
+		// 等待期间缓存区不能超出: 发送时刻不晚于进入设备之后缓存区第一次满的时刻
+		long long reach = (long long) maxEnd + std::max(rules.penalty * f.sendTime - 1, 0) + (len - f.sendTime);
+		int full = waiting.firstAbove(f.startTime, horizon, bufferLimit - 1);
+		if (full >= 0) {
+			reach = std::min(reach, (long long) full + len);
+		}
+		int limit = (int) std::min(reach, (long long) horizon);
+		int bestPort = -1;
+		int bestStart = INT_MAX;
+		for (int p = 0; p < portNum; ++p) {
+			if (p == sink || f.bandwidth > ports[p].bandwidth) {
+				continue;
+			}
+			int s = skylines[p].earliest(f.startTime, len, ports[p].bandwidth - f.bandwidth,
+			                             bestStart == INT_MAX ? limit : bestStart + len);
+			// 同一时刻能放下时选剩余带宽最少的端口
+			if (s >= 0 && (s < bestStart || (s == bestStart &&
+			                                 ports[p].bandwidth - skylines[p].max(s, s + len) <
+			                                 ports[bestPort].bandwidth - skylines[bestPort].max(s, s + len)))) {
+				bestPort = p;
+				bestStart = s;
+			}
+		}
+		if (bestPort < 0) {
+			continue;
+		}
+		skylines[bestPort].add(bestStart, bestStart + len, f.bandwidth);
+		waiting.add(f.startTime, bestStart, 1);
+		maxEnd = std::max(maxEnd, bestStart + f.sendTime);
+		kept[i] = 1;
+		entries.push_back({bestStart, 0, i, bestPort});
+		++report.planned;
+	}
+
+	// 其余的流在进入设备的时刻发到丢弃端口, 同一时刻发送所需时间长的先发
+	std::vector<Key> rest;
+	for (int i = 0; i < n; ++i) {
+		if (!kept[i]) {
+			rest.push_back({flows[i].startTime, -flows[i].sendTime, 0, i});
+		}
+	}
+	std::sort(rest.begin(), rest.end());
+	// 按检查器的规则模拟丢弃端口: 每个时刻先释放发送完毕的流, 再从排队区头部取出放得下的流
+	using Running = std::pair<int, int>;
+	std::priority_queue<Running, std::vector<Running>, std::greater<>> running;
+	std::queue<int> queue;
+	int remain = ports[sink].bandwidth;
+	long long overflow = 0;
+	auto start = [&](int i, int time) {
+		remain -= flows[i].bandwidth;
+		running.emplace(time + std::max(flows[i].sendTime, 1), i);
+		maxEnd = std::max(maxEnd, time + flows[i].sendTime);
+	};
+	auto advance = [&](int time) {
+		while (!running.empty() && running.top().first <= time) {
+			int release = running.top().first;
+			while (!running.empty() && running.top().first == release) {
+				remain += flows[running.top().second].bandwidth;
+				running.pop();
+			}
+			while (!queue.empty() && flows[queue.front()].bandwidth <= remain) {
+				start(queue.front(), release);
+				queue.pop();
+			}
+		}
+	};
+	int sequence = 0;
+	int lastSend = 0;
+	for (const Key &key: rest) {
+		int i = key.flow;
+		const Shape &f = flows[i];
+		advance(f.startTime);
+		if (queue.empty() && f.bandwidth <= remain) {
+			start(i, f.startTime);
+			++report.sunk;
+		} else if ((int) queue.size() < rules.queueLimit) {
+			queue.push(i);
+			++report.sunk;
+		} else {
+			overflow += (long long) rules.penalty * f.sendTime;
+			++report.dropped;
+		}
+		entries.push_back({f.startTime, ++sequence, i, sink});
+		lastSend = std::max(lastSend, f.startTime);
+	}
+	for (const Entry &e: entries) {
+		lastSend = std::max(lastSend, e.time);
+	}
+	// 排队区清空的时刻
+	int drained = lastSend;
+	while (!queue.empty()) {
+		drained = running.top().first;
+		advance(drained);
+	}
+	long long total = std::max(drained, maxEnd) + overflow;
+	report.score = total > INT_MAX ? INT_MAX : (int) total;
+
+	std::sort(entries.begin(), entries.end(), [](const Entry &x, const Entry &y) {
+		return x.time != y.time ? x.time < y.time : x.order < y.order;
+	});
+	results.assign(n, std::vector<int>(3));
+	for (int i = 0; i < n; ++i) {
+		results[i][0] = flows[entries[i].flow].id;
+		results[i][1] = ports[entries[i].port].id;
+		results[i][2] = entries[i].time;
+	}
+	return report;
+}
+
+inline PlanReport plan(const std::list<Flow> &flows, const std::vector<Port> &ports,
+                       std::vector<std::vector<int>> &results, const RuleSet &rules = RuleSet()) {
+	return withRules(rules, [&](const auto &r) {
+		return planWith(flows, ports, results, r);
+	});
+}
+
+}
+
+#endif //ZET_2023_PLANNER_H
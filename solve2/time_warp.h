@@ -0,0 +1,426 @@
+#ifndef ZET_2023_TIME_WARP_H
+#define ZET_2023_TIME_WARP_H
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <ctime>
+#include <deque>
+#include <list>
+#include <thread>
+#include <vector>
+#include "transfer.h"
+#include "backlog.h"
+#include "../common/rules.h"
+
+// 单个大数据集的乐观并行模拟 (Time Warp 式, 实验性): ./solve2 --warp THREADS [--windows K] [--warmup TICKS]
+//   按流的进入时间把时间轴切成 K 个窗口, 每个窗口的流数量大致相同
+//   推测: 第 k 个窗口从 "提前 warmup 个时刻、设备为空" 开始模拟, 到窗口起点时的状态作为预测的起始状态,
+//         窗口内每隔一段时间记一个检查点 (状态 + 已有结果数量), 各窗口在 THREADS 个线程上同时模拟
+//   提交: 按窗口顺序进行, 前一个窗口的真实结束状态与预测的起始状态相同时直接采用推测的结果;
+//         不同时回滚, 从真实状态重新模拟, 到某个检查点时状态与推测的一致就停下, 之后仍采用推测的结果
+// 状态比较要求调度只由状态的内容决定, 与到达这个状态的过程无关:
+//   transfer 的端口选择 (PortSearch / PortIndex) 在剩余带宽相同时保留历史顺序,
+//   正在发送的流在结束时刻相同时的弹出顺序也与堆的历史有关, 两者都无法从内容比较
+//   所以这里的规则与 transferWith (packing = none) 相同, 只是相同时一律按编号:
+//   剩余带宽相同的端口取 id 小的, 结束时刻相同的流按进入顺序释放
+//   得分与 transfer 略有不同 (见说明文档), 结果与同一规则的串行模拟逐条相同
+namespace solver {
+
+struct WarpResult {
+	int id;
+	int port;
+	int time;
+};
+
+struct WarpReport {
+	int score = 0;
+	int windows = 0;
+	// 预测的起始状态不对、需要回滚的窗口数
+	int rollbacks = 0;
+	// 回滚后重新模拟的时刻数 / 总时刻数
+	long long replayed = 0;
+	long long ticks = 0;
+	// 各窗口推测模拟的 CPU 时间之和, 提交阶段 (比较 + 重新模拟) 的时间, 实际耗时
+	double speculated = 0;
+	double committed = 0;
+	double wall = 0;
+	// THREADS 个核心时的估计耗时: 按实际领取顺序把各窗口的 CPU 时间分给线程, 取最晚结束的线程, 再加上提交阶段
+	double modeled = 0;
+	// verify 为 true 时: 串行模拟的耗时, 以及结果是否逐条相同
+	double serial = 0;
+	bool identical = true;
+};
+
+struct WarpOptions {
+	int threads = 1;
+	// 0 : 每个线程 4 个窗口
+	int windows = 0;
+	// -1 : 窗口平均长度的 1/8
+	int warmup = -1;
+	// 每个窗口的检查点数量
+	int checkpoints = 32;
+	// 再串行模拟一次, 比较结果和耗时
+	bool verify = false;
+};
+
+inline double warpClock(clockid_t id) {
+	timespec ts{};
+	clock_gettime(id, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+class WarpEngine {
+public:
+	struct Entry {
+		int id;
+		int bandwidth;
+		int startTime;
+		int sendTime;
+		double compose;
+		double drop;
+	};
+
+	struct Running {
+		int endTime;
+		int index;
+		int port;
+
+		bool operator>(const Running &other) const {
+			return endTime != other.endTime ? endTime > other.endTime : index > other.index;
+		}
+
+		bool operator==(const Running &other) const {
+			return endTime == other.endTime && index == other.index && port == other.port;
+		}
+	};
+
+	// 某个时刻开始时的状态, 不含已经写出的结果和罚时
+	struct State {
+		int time = 0;
+		// 下一个进入设备的流
+		int next = 0;
+		// 缓存区, 按 compose 排列的流下标
+		std::vector<int> dispatch;
+		// 正在发送的流, 按 (结束时刻, 下标) 的最小堆
+		std::vector<Running> running;
+		std::vector<int> remains;
+		std::vector<std::deque<int>> queues;
+		PortBacklog backlog;
+
+		State(const std::vector<int> &portBandwidths, int queueLimit)
+				: remains(portBandwidths), queues(portBandwidths.size()), backlog(portBandwidths, queueLimit) {}
+	};
+
+	struct Checkpoint {
+		State state;
+		size_t results;
+		long long over;
+	};
+
+	// 一个窗口的推测结果: 窗口起点之后的结果和罚时, 检查点 (第一个为窗口起点), 结束状态
+	struct Segment {
+		std::vector<WarpResult> results;
+		long long over = 0;
+		std::vector<Checkpoint> checkpoints;
+		std::vector<State> end;
+		double seconds = 0;
+	};
+
+	WarpEngine(const std::list<Flow> &flows, const std::vector<int> &portBandwidths, double a, double b, double c,
+	           const RuleSet &rules);
+	State initial(int time) const;
+	bool finished(const State &s) const;
+	// 模拟到 until 时刻开始之前 (全部完成时提前停止), out 为空时不记录结果
+	void advance(State &s, int until, std::vector<WarpResult> *out, long long &over) const;
+	// 内容相同的两个状态之后的调度完全相同
+	static bool same(const State &x, const State &y);
+	int size() const;
+	int startOf(int index) const;
+
+private:
+	std::vector<Entry> flows;
+	std::vector<int> bandwidths;
+	RuleSet rules;
+	unsigned maxDispatchFlow;
+	int widestPort;
+
+	int bestFit(const State &s, int bw) const;
+	void enqueue(State &s, int index, int port) const;
+};
+
+inline WarpEngine::WarpEngine(const std::list<Flow> &flows, const std::vector<int> &portBandwidths, double a,
+                              double b, double c, const RuleSet &rules)
+		: bandwidths(portBandwidths), rules(rules) {
+	this->flows.reserve(flows.size());
+	for (const Flow &f: flows) {
+		// 与 transferWith 的计算方式相同, 保证 double 的舍入一样
+		double compose = (double) f.sendTime + a * (double) f.bandwidth + b * f.speed;
+		double drop = (double) f.sendTime + c * (double) f.bandwidth;
+		this->flows.push_back({f.id, f.bandwidth, f.startTime, f.sendTime, compose, drop});
+	}
+	maxDispatchFlow = rules.bufferFactor * portBandwidths.size();
+	widestPort = (int) (std::max_element(portBandwidths.begin(), portBandwidths.end()) - portBandwidths.begin());
+}
+
+inline WarpEngine::State WarpEngine::initial(int time) const {
+	State s(bandwidths, rules.queueLimit);
+	s.time = time;
+	s.next = (int) (std::lower_bound(flows.begin(), flows.end(), time, [](const Entry &e, int t) {
+		return e.startTime < t;
+	}) - flows.begin());
+	return s;
+}
+
+inline int WarpEngine::size() const {
+	return (int) flows.size();
+}
+
+inline int WarpEngine::startOf(int index) const {
+	return flows[index].startTime;
+}
+
+inline bool WarpEngine::finished(const State &s) const {
+	return s.next == (int) flows.size() && s.dispatch.empty() && s.running.empty();
+}
+
+inline int WarpEngine::bestFit(const State &s, int bw) const {
+	int found = -1;
+	for (int id = 0; id < (int) s.remains.size(); ++id) {
+		if (s.remains[id] >= bw && (found < 0 || s.remains[id] < s.remains[found])) {
+			found = id;
+		}
+	}
+	return found;
+}
+
+inline void WarpEngine::enqueue(State &s, int index, int port) const {
+	s.queues[port].push_back(index);
+	s.backlog.add(port, flows[index].bandwidth, flows[index].sendTime);
+}
+
+inline void WarpEngine::advance(State &s, int until, std::vector<WarpResult> *out, long long &over) const {
+	auto record = [&](int index, int port) {
+		if (out != nullptr) {
+			out->push_back({flows[index].id, port, s.time});
+		}
+	};
+	auto start = [&](int index, int port) {
+		s.remains[port] -= flows[index].bandwidth;
+		s.running.push_back({s.time + flows[index].sendTime, index, port});
+		std::push_heap(s.running.begin(), s.running.end(), std::greater<>());
+	};
+	while (s.time < until && !finished(s)) {
+		if (s.dispatch.empty() && s.running.empty() && flows[s.next].startTime > s.time) {
+			// 设备空闲, 排队区也不会再变化, 直接跳到下一个流进入的时刻
+			s.time = std::min(flows[s.next].startTime, until);
+			continue;
+		}
+		while (!s.running.empty() && s.running.front().endTime == s.time) {
+			Running done = s.running.front();
+			std::pop_heap(s.running.begin(), s.running.end(), std::greater<>());
+			s.running.pop_back();
+			int id = done.port;
+			s.remains[id] += flows[done.index].bandwidth;
+			std::deque<int> &queue = s.queues[id];
+			while (!queue.empty() && flows[queue.front()].bandwidth <= s.remains[id]) {
+				int index = queue.front();
+				queue.pop_front();
+				s.backlog.remove(id, flows[index].bandwidth, flows[index].sendTime);
+				start(index, id);
+			}
+		}
+		while (s.next < (int) flows.size() && flows[s.next].startTime == s.time) {
+			int index = s.next++;
+			double compose = flows[index].compose;
+			s.dispatch.insert(std::lower_bound(s.dispatch.begin(), s.dispatch.end(), compose, [&](int x, double v) {
+				return flows[x].compose < v;
+			}), index);
+			if (!rules.queueing || s.dispatch.size() <= maxDispatchFlow) {
+				continue;
+			}
+			// 缓存区已满: 先试着把缓存区第一个流放入排队区, 不行时抛弃 sendTime + c * bandwidth 最小的
+			int front = s.dispatch.front();
+			int port = s.backlog.lightest(flows[front].bandwidth);
+			if (port >= 0) {
+				enqueue(s, front, port);
+				record(front, port);
+				s.dispatch.erase(s.dispatch.begin());
+				continue;
+			}
+			auto f = std::min_element(s.dispatch.begin(), s.dispatch.end(), [&](int x, int y) {
+				return flows[x].drop < flows[y].drop;
+			});
+			port = s.backlog.lightest(flows[*f].bandwidth);
+			if (port >= 0) {
+				enqueue(s, *f, port);
+			} else {
+				port = widestPort;
+				over += (long long) rules.penalty * flows[*f].sendTime;
+			}
+			record(*f, port);
+			s.dispatch.erase(f);
+		}
+		while (!s.dispatch.empty()) {
+			int index = s.dispatch.front();
+			int id = bestFit(s, flows[index].bandwidth);
+			if (id < 0) {
+				break;
+			}
+			record(index, id);
+			start(index, id);
+			s.dispatch.erase(s.dispatch.begin());
+		}
+		++s.time;
+	}
+}
+
+inline bool WarpEngine::same(const State &x, const State &y) {
+	if (x.time != y.time || x.next != y.next || x.dispatch != y.dispatch || x.remains != y.remains ||
+	    x.queues != y.queues || x.running.size() != y.running.size()) {
+		return false;
+	}
+	// 堆的内容相同即可, 排列方式与历史有关
+	std::vector<Running> p(x.running), q(y.running);
+	std::sort(p.begin(), p.end(), std::greater<>());
+	std::sort(q.begin(), q.end(), std::greater<>());
+	return p == q;
+}
+
+// 按 options 切分窗口并行推测, 再按顺序提交, 结果写入 results (与 transfer 相同的格式), 返回得分和统计
+inline WarpReport warpTransfer(const std::list<Flow> &flows, const std::vector<Port> &ports,
+                               std::vector<std::vector<int>> &results, double a, double b, double c,
+                               const RuleSet &rules, const WarpOptions &options) {
+	WarpReport report;
+	double wallStart = warpClock(CLOCK_MONOTONIC);
+	std::vector<int> portBandwidths;
+	for (const Port &port: ports) {
+		portBandwidths.push_back(port.bandwidth);
+	}
+	WarpEngine engine(flows, portBandwidths, a, b, c, rules);
+	int n = engine.size();
+	int threads = std::max(options.threads, 1);
+	int windows = options.windows > 0 ? options.windows : 4 * threads;
+	// 窗口起点: 第 k * n / windows 个流的进入时刻, 去掉重复的
+	std::vector<int> bounds{0};
+	for (int k = 1; k < windows && n > 0; ++k) {
+		int t = engine.startOf((int) ((long long) k * n / windows));
+		if (t > bounds.back()) {
+			bounds.push_back(t);
+		}
+	}
+	windows = (int) bounds.size();
+	bounds.push_back(INT_MAX);
+	report.windows = windows;
+	int span = n > 0 ? std::max(1, (engine.startOf(n - 1) + 1) / windows) : 1;
+	int warmup = options.warmup >= 0 ? options.warmup : span / 8;
+	int every = std::max(1, span / std::max(options.checkpoints, 1));
+
+	// 推测阶段: 每个窗口从空的设备开始, 窗口 0 的起始状态就是真实的
+	std::vector<WarpEngine::Segment> segments(windows);
+	std::atomic<int> claim{0};
+	std::vector<std::vector<int>> claimed(threads);
+	auto speculate = [&](int worker) {
+		for (int k = claim.fetch_add(1); k < windows; k = claim.fetch_add(1)) {
+			claimed[worker].push_back(k);
+			double begin = warpClock(CLOCK_THREAD_CPUTIME_ID);
+			WarpEngine::Segment &seg = segments[k];
+			WarpEngine::State s = engine.initial(k == 0 ? 0 : std::max(0, bounds[k] - warmup));
+			long long ignored = 0;
+			engine.advance(s, bounds[k], nullptr, ignored);
+			while (true) {
+				seg.checkpoints.push_back({s, seg.results.size(), seg.over});
+				if (s.time >= bounds[k + 1] || engine.finished(s)) {
+					break;
+				}
+				engine.advance(s, (int) std::min((long long) s.time + every, (long long) bounds[k + 1]), &seg.results,
+				               seg.over);
+			}
+			seg.end.push_back(std::move(s));
+			seg.seconds = warpClock(CLOCK_THREAD_CPUTIME_ID) - begin;
+		}
+	};
+	std::vector<std::thread> pool;
+	for (int i = 1; i < threads; ++i) {
+		pool.emplace_back(speculate, i);
+	}
+	speculate(0);
+	for (std::thread &t: pool) {
+		t.join();
+	}
+	double busiest = 0;
+	for (const std::vector<int> &list: claimed) {
+		double sum = 0;
+		for (int k: list) {
+			sum += segments[k].seconds;
+			report.speculated += segments[k].seconds;
+		}
+		busiest = std::max(busiest, sum);
+	}
+
+	// 提交阶段
+	double commitStart = warpClock(CLOCK_THREAD_CPUTIME_ID);
+	std::vector<WarpResult> merged;
+	merged.reserve(n);
+	long long over = segments[0].over;
+	merged.insert(merged.end(), segments[0].results.begin(), segments[0].results.end());
+	WarpEngine::State truth = std::move(segments[0].end[0]);
+	for (int k = 1; k < windows; ++k) {
+		WarpEngine::Segment &seg = segments[k];
+		size_t j = 0;
+		if (!WarpEngine::same(truth, seg.checkpoints[0].state)) {
+			++report.rollbacks;
+			int from = truth.time;
+			for (j = 1; j < seg.checkpoints.size(); ++j) {
+				engine.advance(truth, seg.checkpoints[j].state.time, &merged, over);
+				if (WarpEngine::same(truth, seg.checkpoints[j].state)) {
+					break;
+				}
+			}
+			if (j == seg.checkpoints.size()) {
+				// 始终没有重新一致, 这个窗口全部重新模拟
+				engine.advance(truth, bounds[k + 1], &merged, over);
+			}
+			report.replayed += truth.time - from;
+		}
+		if (j < seg.checkpoints.size()) {
+			const WarpEngine::Checkpoint &point = seg.checkpoints[j];
+			merged.insert(merged.end(), seg.results.begin() + (long) point.results, seg.results.end());
+			over += seg.over - point.over;
+			truth = std::move(seg.end[0]);
+		}
+		// 推测结果已经用完, 尽早释放
+		std::vector<WarpResult>().swap(seg.results);
+		seg.checkpoints.clear();
+	}
+	report.committed = warpClock(CLOCK_THREAD_CPUTIME_ID) - commitStart;
+	report.ticks = truth.time;
+	report.score = (int) (truth.time + over);
+	report.modeled = busiest + report.committed;
+	for (int i = 0; i < n; ++i) {
+		results[i][0] = merged[i].id;
+		results[i][1] = merged[i].port;
+		results[i][2] = merged[i].time;
+	}
+	report.wall = warpClock(CLOCK_MONOTONIC) - wallStart;
+
+	if (options.verify) {
+		double begin = warpClock(CLOCK_THREAD_CPUTIME_ID);
+		std::vector<WarpResult> serial;
+		serial.reserve(n);
+		long long serialOver = 0;
+		WarpEngine::State s = engine.initial(0);
+		engine.advance(s, INT_MAX, &serial, serialOver);
+		report.serial = warpClock(CLOCK_THREAD_CPUTIME_ID) - begin;
+		report.identical = s.time + serialOver == report.score && serial.size() == merged.size();
+		for (size_t i = 0; report.identical && i < serial.size(); ++i) {
+			report.identical = serial[i].id == merged[i].id && serial[i].port == merged[i].port &&
+			                   serial[i].time == merged[i].time;
+		}
+	}
+	return report;
+}
+
+}
+
+#endif //ZET_2023_TIME_WARP_H
@@ -0,0 +1,218 @@
+#ifndef ZET_2023_TIMELINE_H
+#define ZET_2023_TIMELINE_H
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 端口占用时间线记录器
+// 每个时刻结束时把状态发生变化的端口 (剩余带宽、排队区长度) 和缓存区大小写盘,
+// 同时输出两种格式:
+//   json : Chrome trace / Perfetto 可直接打开的 counter 事件, 1 个时刻对应 1us
+//   bin  : 紧凑二进制时间序列, 供 numpy 批量分析
+// 二进制格式 (小端):
+//   文件头 "ZTL1" | uint32 端口数 | int32 端口带宽 * 端口数
+//   记录   int32 time | int16 port | int16 queue | int32 value   (12 字节)
+//   port == -1 的记录表示缓存区, value 为缓存区中流的数量; 否则 value 为端口剩余带宽
+class TimelineRecorder {
+public:
+	TimelineRecorder(const std::string &jsonPath, const std::string &binPath, const std::vector<int> &bandwidths);
+	~TimelineRecorder();
+	bool isOpen() const;
+	// 端口状态变化, 同一时刻内多次变化只保留最后一次
+	void port(int id, int remain, int queued);
+	// 只有排队区长度变化 (剩余带宽不变)
+	void queue(int id, int queued);
+	// 缓存区大小变化
+	void buffer(int size);
+	// 当前时刻结束, 把这一时刻的变化写出
+	void tick(int time);
+	void close();
+
+private:
+#pragma pack(push, 1)
+	struct Record {
+		int32_t time;
+		int16_t port;
+		int16_t queue;
+		int32_t value;
+	};
+#pragma pack(pop)
+
+	FILE *json;
+	FILE *bin;
+	int bufferSize;
+	bool bufferDirty;
+	std::vector<int> remain;
+	std::vector<int> queued;
+	std::vector<int> dirty;
+	std::vector<char> isDirty;
+	std::vector<char> jsonBuf;
+	std::vector<Record> binBuf;
+
+	void appendJson(const char *s, size_t n);
+	void appendInt(long long v);
+	void flushJson();
+	void flushBin();
+};
+
+inline TimelineRecorder::TimelineRecorder(const std::string &jsonPath, const std::string &binPath,
+                                          const std::vector<int> &bandwidths) {
+	json = jsonPath.empty() ? nullptr : fopen(jsonPath.c_str(), "wb");
+	bin = binPath.empty() ? nullptr : fopen(binPath.c_str(), "wb");
+	bufferSize = 0;
+	bufferDirty = false;
+	unsigned portNum = bandwidths.size();
+	remain = bandwidths;
+	queued.assign(portNum, 0);
+	isDirty.assign(portNum, 0);
+	jsonBuf.reserve(1 << 20);
+	binBuf.reserve(1 << 16);
+	if (json != nullptr) {
+		const char head[] = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+		                    "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"switch\"}}";
+		appendJson(head, sizeof(head) - 1);
+	}
+	if (bin != nullptr) {
+		uint32_t n = portNum;
+		fwrite("ZTL1", 1, 4, bin);
+		fwrite(&n, sizeof(n), 1, bin);
+		for (unsigned i = 0; i < portNum; ++i) {
+			int32_t bw = bandwidths[i];
+			fwrite(&bw, sizeof(bw), 1, bin);
+		}
+	}
+	// 初始状态: 所有端口空闲
+	for (unsigned i = 0; i < portNum; ++i) {
+		port((int) i, bandwidths[i], 0);
+	}
+	bufferDirty = true;
+	tick(0);
+}
+
+inline TimelineRecorder::~TimelineRecorder() {
+	close();
+}
+
+inline bool TimelineRecorder::isOpen() const {
+	return json != nullptr || bin != nullptr;
+}
+
+inline void TimelineRecorder::port(int id, int r, int q) {
+	remain[id] = r;
+	queued[id] = q;
+	if (!isDirty[id]) {
+		isDirty[id] = 1;
+		dirty.push_back(id);
+	}
+}
+
+inline void TimelineRecorder::queue(int id, int q) {
+	port(id, remain[id], q);
+}
+
+inline void TimelineRecorder::buffer(int size) {
+	if (size != bufferSize) {
+		bufferSize = size;
+		bufferDirty = true;
+	}
+}
+
+inline void TimelineRecorder::tick(int time) {
+	for (int id: dirty) {
+		isDirty[id] = 0;
+		if (bin != nullptr) {
+			binBuf.push_back({time, (int16_t) id, (int16_t) queued[id], remain[id]});
+		}
+		if (json != nullptr) {
+			const char a[] = ",\n{\"ph\":\"C\",\"pid\":1,\"name\":\"port ";
+			const char b[] = "\",\"ts\":";
+			const char c[] = ",\"args\":{\"remainBandwidth\":";
+			const char d[] = ",\"queue\":";
+			appendJson(a, sizeof(a) - 1);
+			appendInt(id);
+			appendJson(b, sizeof(b) - 1);
+			appendInt(time);
+			appendJson(c, sizeof(c) - 1);
+			appendInt(remain[id]);
+			appendJson(d, sizeof(d) - 1);
+			appendInt(queued[id]);
+			appendJson("}}", 2);
+		}
+	}
+	dirty.clear();
+	if (bufferDirty) {
+		bufferDirty = false;
+		if (bin != nullptr) {
+			binBuf.push_back({time, -1, 0, bufferSize});
+		}
+		if (json != nullptr) {
+			const char a[] = ",\n{\"ph\":\"C\",\"pid\":1,\"name\":\"dispatch buffer\",\"ts\":";
+			const char b[] = ",\"args\":{\"size\":";
+			appendJson(a, sizeof(a) - 1);
+			appendInt(time);
+			appendJson(b, sizeof(b) - 1);
+			appendInt(bufferSize);
+			appendJson("}}", 2);
+		}
+	}
+	if (jsonBuf.size() >= (1 << 20) - 4096) {
+		flushJson();
+	}
+	if (binBuf.size() >= (1 << 16) - 1024) {
+		flushBin();
+	}
+}
+
+inline void TimelineRecorder::close() {
+	if (json != nullptr) {
+		appendJson("\n]}\n", 4);
+		flushJson();
+		fclose(json);
+		json = nullptr;
+	}
+	if (bin != nullptr) {
+		flushBin();
+		fclose(bin);
+		bin = nullptr;
+	}
+}
+
+inline void TimelineRecorder::appendJson(const char *s, size_t n) {
+	jsonBuf.insert(jsonBuf.end(), s, s + n);
+}
+
+inline void TimelineRecorder::appendInt(long long v) {
+	// 手写整数格式化, fprintf 在这里会成为瓶颈
+	char tmp[24];
+	int n = 0;
+	bool neg = v < 0;
+	unsigned long long u = neg ? 0ULL - (unsigned long long) v : (unsigned long long) v;
+	do {
+		tmp[n++] = (char) ('0' + u % 10);
+		u /= 10;
+	} while (u != 0);
+	if (neg) {
+		tmp[n++] = '-';
+	}
+	while (n > 0) {
+		jsonBuf.push_back(tmp[--n]);
+	}
+}
+
+inline void TimelineRecorder::flushJson() {
+	if (json != nullptr && !jsonBuf.empty()) {
+		fwrite(jsonBuf.data(), 1, jsonBuf.size(), json);
+	}
+	jsonBuf.clear();
+}
+
+inline void TimelineRecorder::flushBin() {
+	if (bin != nullptr && !binBuf.empty()) {
+		fwrite(binBuf.data(), sizeof(Record), binBuf.size(), bin);
+	}
+	binBuf.clear();
+}
+
+#endif //ZET_2023_TIMELINE_H
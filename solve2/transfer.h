@@ -0,0 +1,506 @@
+#ifndef ZET_2023_TRANSFER_H
+#define ZET_2023_TRANSFER_H
+
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <vector>
+#include <list>
+#include <queue>
+#include "timeline.h"
+#include "backlog.h"
+#include "dispatch.h"
+#include "../common/port_search.h"
+#include "../common/port_index.h"
+#include "../common/batch_pack.h"
+#include "../common/rules.h"
+#include "../common/result_ring.h"
+#include "../common/latency.h"
+
+// solve2 的调度核心, 单独放在头文件里供 solve2 和常驻调度服务共用
+namespace solver {
+
+class Flow {
+public:
+	// startTime : 进入设备时间
+	// sendTime : 发送所需时间
+	// beginTime : 端口发送开始时间
+	// index : 在 transfer 的流数组中的下标, 端口排队区中存放的是这个下标
+	int id;
+	int index;
+	int portId;
+	int bandwidth;
+	int startTime;
+	int beginTime;
+	int endTime;
+	int sendTime;
+	double speed;
+	double compose;
+
+	explicit Flow(int id = -1, int bandwidth = 0, int startTime = 0, int sendTime = 0);
+	bool isNull() const;
+	void setBeginTime(int bt);
+	void setEndTime(int bt);
+	bool operator<(const Flow &other) const;
+	bool operator>(const Flow &other) const;
+	bool operator==(const Flow &other) const;
+};
+
+inline Flow::Flow(int id, int bandwidth, int startTime, int sendTime) {
+	this->id = id;
+	this->index = -1;
+	this->portId = -1;
+	this->bandwidth = bandwidth;
+	this->startTime = startTime;
+	this->sendTime = sendTime;
+	this->beginTime = 0;
+	this->endTime = INT_MAX;
+	this->speed = (double) bandwidth / (double) sendTime;
+}
+
+inline bool Flow::isNull() const {
+	return id == -1;
+}
+
+inline void Flow::setBeginTime(int bt) {
+	this->beginTime = bt;
+}
+
+inline void Flow::setEndTime(int bt) {
+	this->endTime = bt + sendTime;
+}
+
+inline bool Flow::operator<(const Flow &other) const {
+	return this->endTime < other.endTime;
+}
+
+inline bool Flow::operator>(const Flow &other) const {
+	return this->endTime > other.endTime;
+}
+
+inline bool Flow::operator==(const Flow &other) const {
+	return this->endTime == other.endTime;
+}
+
+class Port {
+public:
+	int id;
+	int bandwidth;
+	int remainBandwidth;
+
+	Port(int id, int bandwidth);
+	bool modifyRemain(int bw);
+	bool operator<(const Port &other) const;
+	bool operator==(const Port &other) const;
+	bool operator>(const Port &other) const;
+};
+
+inline Port::Port(int id, int bandwidth) {
+	this->id = id;
+	this->bandwidth = bandwidth;
+	this->remainBandwidth = bandwidth;
+}
+
+inline bool Port::modifyRemain(int bw) {
+	if (bw > remainBandwidth) {
+		return false;
+	}
+	remainBandwidth -= bw;
+	return true;
+}
+
+inline bool Port::operator<(const Port &other) const {
+	return this->remainBandwidth < other.remainBandwidth;
+}
+
+inline bool Port::operator>(const Port &other) const {
+	return this->remainBandwidth > other.remainBandwidth;
+}
+
+inline bool Port::operator==(const Port &other) const {
+	return this->remainBandwidth == other.remainBandwidth;
+}
+
+// 读取流文件
+inline void loadFlow(const char *filePath, std::list<Flow> &flows) {
+	FILE *fpRead = fopen(filePath, "r");
+	if (fpRead == nullptr) {
+		return;
+	}
+	int id;
+	int bandwidth;
+	int startTime;
+	int sendTime;
+	// 忽略第一行
+	fscanf(fpRead, "%*[^\n]%*c");
+	while (fscanf(fpRead, "%d,%d,%d,%d\n", &id, &bandwidth, &startTime, &sendTime) != EOF) {
+		flows.emplace_back(id, bandwidth, startTime, sendTime);
+	}
+	fclose(fpRead);
+}
+
+// 读取端口文件
+inline void loadPort(const char *filePath, std::vector<Port> &posts) {
+	FILE *fpRead = fopen(filePath, "r");
+	if (fpRead == nullptr) {
+		return;
+	}
+	int id;
+	int bandwidth;
+	// 忽略第一行
+	fscanf(fpRead, "%*[^\n]%*c");
+	while (fscanf(fpRead, "%d,%d\n", &id, &bandwidth) != EOF) {
+		posts.emplace_back(id, bandwidth);
+	}
+	fclose(fpRead);
+}
+
+// 调度的目标: makespan 为总时间 (最后发送完毕的时刻 + 丢弃罚时, 比赛的计分), tail 为 p99 等待时间,
+// weighted 为按带宽加权的平均完成时间
+enum class Objective {
+	makespan, tail, weighted
+};
+
+inline bool parseObjective(const char *name, Objective &objective) {
+	if (strcmp(name, "makespan") == 0) {
+		objective = Objective::makespan;
+	} else if (strcmp(name, "tail") == 0) {
+		objective = Objective::tail;
+	} else if (strcmp(name, "weighted") == 0) {
+		objective = Objective::weighted;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+// 缓存区的排序键 (compose), 越小越先发送, 进入缓存区时算一次:
+//   makespan / tail : sendTime + a * bandwidth + b * speed (原来的 compose)
+//   weighted        : sendTime / bandwidth (Smith 规则, 单机上使加权完成时间之和最小的顺序)
+// 再加上 aging * startTime: 流在缓存区中每等一个时刻优先级提高 aging, 所有流的提高速度相同,
+// 所以 "键 - aging * 当前时刻" 的先后等于 "键 + aging * 进入时刻" 的先后, 键仍然不随时间变化, 缓存区每次操作还是 O(log n)
+// 也可以看作截止时刻 startTime + 键 / aging 最早的先发送; aging 很大时接近先进先出
+struct BufferKey {
+	Objective objective = Objective::makespan;
+	double aging = 0;
+
+	double operator()(const Flow &f, const double &a, const double &b) const {
+		double key = objective == Objective::weighted
+		             ? (double) f.sendTime / (double) std::max(f.bandwidth, 1)
+		             : (double) f.sendTime + a * (double) f.bandwidth + b * f.speed;
+		return aging == 0 ? key : key + aging * (double) f.startTime;
+	}
+};
+
+// 调度过程中的事件, scheduleWith 按发生的顺序调用:
+//   assign(f, port, time) : 流 f 的结果 (进入排队区、被丢弃或直接发送), 按结果文件的顺序
+//   start(f, time)        : 流 f 开始发送 (直接从缓存区发送, 或从排队区取出)
+//   drop(f, time)         : 流 f 被丢弃, 在它的 assign 之后
+// 写结果文件只用 assign; 只统计指标的调用方 (如 whatif) 不需要保存每个流的结果
+// latency 不为空时同时记录每个流的延迟 (common/latency.h)
+struct ResultWriter {
+	std::vector<std::vector<int>> &results;
+	LatencyTracker *latency = nullptr;
+	int pos = 0;
+
+	void assign(const Flow &f, int port, int time) {
+		results[pos][0] = f.id;
+		results[pos][1] = port;
+		results[pos][2] = time;
+		++pos;
+		if (latency != nullptr) {
+			latency->leave(f.index, port, f.startTime, time);
+		}
+	}
+
+	void start(const Flow &f, int time) {
+		if (latency != nullptr) {
+			latency->start(f.index, f.bandwidth, f.startTime, time, f.sendTime);
+		}
+	}
+
+	void drop(const Flow &f, int) {
+		if (latency != nullptr) {
+			latency->drop(f.index, f.bandwidth);
+		}
+	}
+};
+
+// pool 为按进入设备的顺序排好的所有流, pool[i].index == i, 只读, 多个调度可以共用同一份
+template<class R, class Ports, class Sink>
+inline int scheduleWith(const std::vector<Flow> &pool, Ports &ports, const std::vector<int> &portBandwidths,
+                        Sink &sink, const double &a, const double &b, const double &c, TimelineRecorder *timeline,
+                        const R &rules, Packing packing = Packing::none, const BufferKey &key = BufferKey()) {
+	// FILE *fpWrite = fopen(resultsFile.c_str(), "w");
+	unsigned portNum = portBandwidths.size();
+	// 记录最大剩余带宽
+	int maxRemainBandwidth = ports.maxRemain();
+	int time = 0;
+	// 抛弃流罚时
+	int over = 0;
+	// 下一个进入设备的流
+	size_t next = 0;
+	Flow temp;
+	Flow flow, flowAtPort, flowAtDispatch;
+	// 所以端口共用的堆，记录端口正在发送的流
+	std::priority_queue<Flow, std::vector<Flow>, std::greater<>> min_heap;
+	// 缓存区, 按 compose (key 算出的排序键) 排列 (见 dispatch.h)
+	DispatchBuffer dispatch;
+	// 端口排队去
+	PortQueues<R> portQueues(portNum);
+	// 缓存区数量限制
+	unsigned maxDispatchFlow = rules.bufferFactor * portNum;
+	// 每个端口排队区中的总量 (带宽 * 发送所需时间), 缓存区溢出时选最早排空的排队区
+	PortBacklog backlog(portBandwidths, rules.queueLimit);
+	// 带宽最大的端口, 被丢弃的流记在这个端口上
+	int widestPort = (int) (std::max_element(portBandwidths.begin(), portBandwidths.end()) - portBandwidths.begin());
+	// packing 不为 none 时每个时刻把缓存区中的流一起装箱 (common/batch_pack.h), 只在有流进入或发送完毕的时刻进行
+	BatchPacker packer;
+	std::vector<int> bins(portNum);
+	std::vector<int> items;
+	std::vector<int> assigned;
+	bool changed = false;
+	while (next < pool.size() || !dispatch.empty() || !min_heap.empty()) {
+		flow = (next < pool.size() ? pool[next] : temp);
+		flow.compose = key(flow, a, b);
+		flowAtPort = (!min_heap.empty() ? min_heap.top() : temp);
+		while (!flowAtPort.isNull() && flowAtPort.endTime == time) {
+			// 弹出已经发送完毕的流，修改端口剩余带宽，检查排队区是否有流要发送
+			int id = flowAtPort.portId;
+			changed = true;
+			ports.modify(id, -flowAtPort.bandwidth);
+			min_heap.pop();
+			while (!portQueues.empty(id) && pool[portQueues.front(id)].bandwidth <= ports.remain(id)) {
+				Flow flowAtPortQueue = pool[portQueues.front(id)];
+				flowAtPortQueue.setBeginTime(time);
+				flowAtPortQueue.setEndTime(time);
+				flowAtPortQueue.portId = id;
+				sink.start(flowAtPortQueue, time);
+				min_heap.push(flowAtPortQueue);
+				ports.modify(id, flowAtPortQueue.bandwidth);
+				portQueues.pop(id);
+				backlog.remove(id, flowAtPortQueue.bandwidth, flowAtPortQueue.sendTime);
+			}
+			if (timeline != nullptr) {
+				timeline->port(id, ports.remain(id), portQueues.size(id));
+			}
+			ports.commit(id);
+			maxRemainBandwidth = ports.maxRemain();
+			flowAtPort = (!min_heap.empty() ? min_heap.top() : temp);
+		}
+		while (!flow.isNull() && flow.startTime == time) {
+			// 流内的数据不能直接发送到端口，只能通过排队区和缓存区发送到端口
+			// (2.3, 7.9) + (0.8, 0.0) --> 50.52
+			dispatch.insert(flow.index, flow.compose, (double) flow.sendTime + c * (double) flow.bandwidth);
+			if (R::queueing && dispatch.size() > maxDispatchFlow) {
+				flowAtDispatch = pool[dispatch.front().index];
+				// 缓存区已满, 想要把流放入端口排队区, 取未满的排队区中最早排空的一个 (见 backlog.h)
+				// 优化思路: 如果排队区已满则抛弃 sendTime 最小的, 如果未满, 将带宽最小的放入排队区
+				// 优化后 50.35 --> 50.35(a = 0.1) 50.47(a = 0.8)
+				int portPos = backlog.lightest(flowAtDispatch.bandwidth);
+				if (portPos >= 0) {
+					flowAtDispatch.portId = portPos;
+					portQueues.push(portPos, flowAtDispatch.index);
+					backlog.add(portPos, flowAtDispatch.bandwidth, flowAtDispatch.sendTime);
+					if (timeline != nullptr) {
+						timeline->queue(portPos, portQueues.size(portPos));
+					}
+					// fprintf(fpWrite, "%d,%d,%d\n", flowAtDispatch.id, portPos, time);
+					// cout << flowAtDispatch.id << "," << portPos << "," << time << endl;
+					sink.assign(flowAtDispatch, portPos, time);
+					dispatch.erase(dispatch.begin());
+				} else {
+					// 缓存区和排队区都超限，选取 sendTime + c * bandwidth 最小的抛弃 (c = 0 时即发送时间最小)
+					const DispatchBuffer::Entry &cheapest = dispatch.cheapest();
+					const Flow *f = &pool[cheapest.index];
+					portPos = backlog.lightest(f->bandwidth);
+					bool dropped = portPos < 0;
+					if (!dropped) {
+						portQueues.push(portPos, f->index);
+						backlog.add(portPos, f->bandwidth, f->sendTime);
+						if (timeline != nullptr) {
+							timeline->queue(portPos, portQueues.size(portPos));
+						}
+					} else {
+						// 所有放得下的端口排队区都满了, 流被丢弃, 结果中仍然要给一个放得下的端口
+						portPos = widestPort;
+						over += (rules.penalty * f->sendTime);
+					}
+					// fprintf(fpWrite, "%d,%d,%d\n", f->id, portPos, time);
+					// cout << f->id << "," << portPos << "," << f->sendTime << endl;
+					sink.assign(*f, portPos, time);
+					if (dropped) {
+						sink.drop(*f, time);
+					}
+					dispatch.erase(cheapest);
+				}
+			}
+			++next;
+			changed = true;
+			flow = (next < pool.size() ? pool[next] : temp);
+			flow.compose = key(flow, a, b);
+		}
+		if (packing != Packing::none && changed && !dispatch.empty()) {
+			changed = false;
+			items.clear();
+			for (const DispatchBuffer::Entry &e: dispatch) {
+				items.push_back(pool[e.index].bandwidth);
+			}
+			for (int id = 0; id < (int) portNum; ++id) {
+				bins[id] = ports.remain(id);
+			}
+			int placed = packer.pack(bins, items, assigned, packing);
+			auto f = dispatch.begin();
+			for (int k = 0; placed > 0; ++k) {
+				int id = assigned[k];
+				if (id < 0) {
+					++f;
+					continue;
+				}
+				Flow sent = pool[f->index];
+				sent.setBeginTime(time);
+				sent.setEndTime(time);
+				sent.portId = id;
+				sink.assign(sent, id, time);
+				sink.start(sent, time);
+				min_heap.push(sent);
+				ports.modify(id, sent.bandwidth);
+				if (timeline != nullptr) {
+					timeline->port(id, ports.remain(id), portQueues.size(id));
+				}
+				ports.commit(id);
+				f = dispatch.erase(f);
+				--placed;
+			}
+			maxRemainBandwidth = ports.maxRemain();
+		}
+		while (packing == Packing::none && !dispatch.empty()) {
+			// 检查端口是否有空闲带宽，并发送
+			flowAtDispatch = pool[dispatch.front().index];
+			if (flowAtDispatch.bandwidth <= maxRemainBandwidth) {
+				int id = ports.bestFit(flowAtDispatch.bandwidth);
+				flowAtDispatch.setBeginTime(time);
+				flowAtDispatch.setEndTime(time);
+				flowAtDispatch.portId = id;
+				// fprintf(fpWrite, "%d,%d,%d\n", flowAtDispatch.id, flowAtDispatch.portId, flowAtDispatch.beginTime);
+				// cout << flowAtDispatch.id << "," << flowAtDispatch.portId << "," << flowAtDispatch.beginTime << endl;
+				sink.assign(flowAtDispatch, id, time);
+				sink.start(flowAtDispatch, time);
+				min_heap.push(flowAtDispatch);
+				ports.modify(id, flowAtDispatch.bandwidth);
+				if (timeline != nullptr) {
+					timeline->port(id, ports.remain(id), portQueues.size(id));
+				}
+				ports.commit(id);
+				maxRemainBandwidth = ports.maxRemain();
+				dispatch.erase(dispatch.begin());
+			} else {
+				break;
+			}
+		}
+		if (timeline != nullptr) {
+			timeline->buffer((int) dispatch.size());
+			timeline->tick(time);
+		}
+		++time;
+	}
+	// fclose(fpWrite);
+	return time + over;
+}
+
+template<class R, class Ports>
+inline int transferWith(std::list<Flow> &flows, Ports &ports, const std::vector<int> &portBandwidths,
+                        std::vector<std::vector<int>> &results, const double &a, const double &b, const double &c,
+                        TimelineRecorder *timeline, const R &rules, Packing packing = Packing::none,
+                        LatencyTracker *latency = nullptr, const BufferKey &key = BufferKey()) {
+	// 所有流按进入设备的顺序编号, 端口排队区只保存下标
+	std::vector<Flow> pool;
+	pool.reserve(flows.size());
+	for (auto &f: flows) {
+		f.index = (int) pool.size();
+		pool.push_back(f);
+	}
+	ResultWriter writer{results, latency};
+	return scheduleWith(pool, ports, portBandwidths, writer, a, b, c, timeline, rules, packing, key);
+}
+
+// 端口数量不超过 64 时使用 SIMD 端口选择, 否则使用按容量等级的两级索引 (common/port_index.h), 两者的选择规则相同
+// rules 为比赛规则时使用编译期常数的实例, 见 common/rules.h
+// packing 不为 none 时每个时刻缓存区中的流一起装箱, 见 common/batch_pack.h
+// latency 不为空时记录每个流的延迟, 流的下标为按进入设备排序后的位置
+// key 为缓存区的排序键, 默认为原来的 compose (见 BufferKey)
+inline int transfer(std::list<Flow> flows, std::vector<Port> ports, std::vector<std::vector<int>> &results,
+                    const double &a, const double &b, const double &c = 0,
+                    TimelineRecorder *timeline = nullptr, const RuleSet &rules = RuleSet(),
+                    Packing packing = Packing::none, LatencyTracker *latency = nullptr,
+                    const BufferKey &key = BufferKey()) {
+	std::vector<int> portBandwidths(ports.size());
+	for (size_t i = 0; i < ports.size(); ++i) {
+		portBandwidths[i] = ports[i].bandwidth;
+	}
+	return withRules(rules, [&](const auto &r) {
+		if (PortSearch::fits(portBandwidths)) {
+			PortSearch small(portBandwidths, false);
+			return transferWith(flows, small, portBandwidths, results, a, b, c, timeline, r, packing, latency, key);
+		}
+		PortIndex wide(portBandwidths, false);
+		return transferWith(flows, wide, portBandwidths, results, a, b, c, timeline, r, packing, latency, key);
+	});
+}
+
+// 与 transfer 相同的端口选择和规则选择, 但流数组由调用方准备好 (见 scheduleWith), 调度过程交给 sink
+template<class Sink>
+inline int schedule(const std::vector<Flow> &pool, const std::vector<int> &portBandwidths, Sink &sink,
+                    const double &a, const double &b, const double &c = 0, const RuleSet &rules = RuleSet()) {
+	return withRules(rules, [&](const auto &r) {
+		if (PortSearch::fits(portBandwidths)) {
+			PortSearch small(portBandwidths, false);
+			return scheduleWith(pool, small, portBandwidths, sink, a, b, c, nullptr, r);
+		}
+		PortIndex wide(portBandwidths, false);
+		return scheduleWith(pool, wide, portBandwidths, sink, a, b, c, nullptr, r);
+	});
+}
+
+// 写入结果, binary 为 true 时写 "ZRS1" 开头的二进制格式 (每条结果 3 个 int32), determine_2 --stdin 可以直接读取
+inline void write_stream(FILE *fpWrite, std::vector<std::vector<int>> &results, const unsigned long &num,
+                         bool binary) {
+	if (binary) {
+		fwrite("ZRS1", 1, 4, fpWrite);
+		for (size_t i = 0; i < num; ++i) {
+			fwrite(results[i].data(), sizeof(int), 3, fpWrite);
+		}
+		return;
+	}
+	for (size_t i = 0; i < num; ++i) {
+		fprintf(fpWrite, "%d,%d,%d\n", results[i][0], results[i][1], results[i][2]);
+	}
+}
+
+// 写入文件
+inline void write_file(const char *outFilePath, std::vector<std::vector<int>> &results, const unsigned long &num) {
+	FILE *fpWrite = fopen(outFilePath, "w");
+	write_stream(fpWrite, results, num, false);
+	fclose(fpWrite);
+}
+
+// 写入共享内存环形缓冲区, 读端跟不上时会在这里等待; 读端提前结束 (结果不合法)、长时间不读或写完后一直没有打开时返回 false
+inline bool write_shm(const std::string &name, int dataset, std::vector<std::vector<int>> &results,
+                      const unsigned long &num) {
+	ResultRing *ring = ResultRing::create(name, dataset);
+	if (ring == nullptr) {
+		return false;
+	}
+	bool ok = true;
+	for (size_t i = 0; i < num && ok; ++i) {
+		ok = ring->push(results[i][0], results[i][1], results[i][2]);
+	}
+	ok = ring->finish() && ok;
+	delete ring;
+	return ok;
+}
+
+}
+
+#endif //ZET_2023_TRANSFER_H
@@ -4,6 +4,9 @@
 #include <list>
 #include <queue>
 #include <climits>
+#include <cstring>
+#include <cstdlib>
+#include "../common/halving.h"
 
 using namespace std;
 
@@ -173,8 +176,7 @@ int binary_search(vector<Port> &posts, int bandwidth) {
 	return res;
 }
 
-int transfer(list<Flow> flows, vector<Port> ports, const string &resultsFile, double &a, double &b) {
-	FILE *fpWrite = fopen(resultsFile.c_str(), "w");
+int transfer(list<Flow> flows, vector<Port> ports, const string &/*resultsFile*/, double &a, double &b) {
 	unsigned portNum = ports.size();
 	sort(ports.begin(), ports.end(), less<>());
 	int maxRemainBandwidth = ports[portNum - 1].remainBandwidth;
@@ -238,8 +240,71 @@ void write_file(const char *outFilePath, vector<vector<double>> &results, const
 	fclose(fpWrite);
 }
 
-int main() {
+// 多保真度扫描: 候选 (a, b) 按穷举的顺序编号, 先在短前缀上打分淘汰, 再逐级加长前缀
+// verify 为 true 时再穷举一遍同样的网格, 检查两者选出的权重是否相同
+void halving(list<Flow> &flows, vector<Port> &ports, const string &resultsFilePath, int step, double start,
+             double keep, bool verify) {
+	vector<pair<double, double>> grid;
+	for (int i = -200; i <= 200; i += step) {
+		for (int j = -200; j <= 200; j += step) {
+			grid.emplace_back(double(i) / 10, double(j) / 10);
+		}
+	}
+	vector<list<Flow>> prefixes = prefixFlows(flows, halvingRungs(start));
+	HalvingResult r = successiveHalving((int) grid.size(), start, keep, [&](int candidate, int rung) {
+		double a = grid[candidate].first;
+		double b = grid[candidate].second;
+		return (long long) transfer(prefixes[rung], ports, resultsFilePath, a, b);
+	});
+	long long events = 0;
+	for (int k = 0; k < (int) r.evaluated.size(); ++k) {
+		cout << r.rungs[k] * 100 << "%:" << r.evaluated[k] << " ";
+		events += (long long) r.evaluated[k] * prefixes[k].size();
+	}
+	long long fullEvents = (long long) grid.size() * flows.size();
+	cout << endl;
+	cout << grid[r.best].first << "," << grid[r.best].second << "," << r.score << endl;
+	cout << "simulated flows: " << events << " / " << fullEvents << " (" << 100.0 * events / fullEvents << "%)" << endl;
+	if (verify) {
+		int ret = INT_MAX;
+		int best = -1;
+		for (int k = 0; k < (int) grid.size(); ++k) {
+			int ret1 = transfer(flows, ports, resultsFilePath, grid[k].first, grid[k].second);
+			if (ret1 < ret) {
+				ret = ret1;
+				best = k;
+			}
+		}
+		cout << "exhaustive: " << grid[best].first << "," << grid[best].second << "," << ret
+		     << (best == r.best ? " match" : " MISMATCH") << endl;
+	}
+}
+
+int main(int argc, char *argv[]) {
 	int dirNum = 0;
+	// --halving [--start 0.1] [--keep 0.25] [--step 1] [--verify] : 多保真度扫描代替穷举
+	//     start 为第一级前缀比例 (按进入设备时间), keep 为每级保留的候选比例, step 为网格步长 (单位 0.1)
+	// --root 目录 : 数据集根目录, 默认 ../testData_1
+	bool useHalving = false;
+	bool verify = false;
+	double start = 0.1;
+	double keep = 0.25;
+	int step = 1;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--halving") == 0) {
+			useHalving = true;
+		} else if (strcmp(argv[i], "--verify") == 0) {
+			verify = true;
+		} else if (strcmp(argv[i], "--start") == 0 && i + 1 < argc) {
+			start = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--keep") == 0 && i + 1 < argc) {
+			keep = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--step") == 0 && i + 1 < argc) {
+			step = max(atoi(argv[++i]), 1);
+		} else if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
+			dataPath = argv[++i];
+		}
+	}
 	auto lambda = [&](Flow first, Flow second) {
 		if (first.startTime != second.startTime) {
 			return first.startTime < second.startTime;
@@ -268,10 +333,16 @@ int main() {
 		loadFlow(flowsFilePath.c_str(), flows);
 		loadPort(portsFilePath.c_str(), ports);
 
-		FILE *fpWrite = fopen(resultsFilePath.c_str(), "w");
 		flows.sort([](Flow &first, Flow &second) {
 			return first.startTime < second.startTime;
 		});
+		if (useHalving) {
+			cout << "第" << dirNum << "号文件：" << endl;
+			halving(flows, ports, resultsFilePath, step, start, keep, verify);
+			dirNum++;
+			continue;
+		}
+		FILE *fpWrite = fopen(resultsFilePath.c_str(), "w");
 		int ret = INT_MAX;
 		double pa;
 		double pb;
@@ -273,6 +273,7 @@ int transfer(list<Flow> flows, vector<Port> ports, vector<vector<int>> &results,
 			flows.pop_front();
 			flow = (!flows.empty() ? flows.front() : temp);
 			flow.compose = (double) flow.sendTime + a * (double) flow.bandwidth + b * flow.speed;
+			flow.score = double(flow.sendTime) + c * double(flow.bandwidth);
 		}
 		while (!dispatch.empty()) {
 			flowAtDispatch = dispatch.front();
@@ -0,0 +1,293 @@
+#include <iostream>
+#include <vector>
+#include <list>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <sys/resource.h>
+#include <time.h>
+#include "../solve2/transfer.h"
+
+using namespace std;
+
+// 容量规划: 同一个数据集在一组 "规则常数 x 端口组合" 上各调度一次, 输出每种配置的总时间、丢弃和等待时间
+// 所有配置共用一份只读的流数组 (solver::scheduleWith), 每个配置只有自己的端口、缓存区、排队区和正在发送的流,
+// 不保存每个流的结果, 指标在调度过程中累计, 所以几百个配置同时计算时内存也只比一份流数组多一点
+//
+// ./whatif 数据目录 [--buffer 20,40] [--queue 30,60] [--penalty 2] [--mix MIX]... [--jobs N]
+//   数据目录中为 flow.txt 和 port.txt
+//   --buffer / --queue / --penalty : 缓存区系数 (容量 = 系数 * 端口数)、排队区容量、丢弃罚时系数的取值, 逗号分隔, 默认为比赛规则
+//       缓存区系数和排队区容量至少为 1: 缓存区系数为 0 时流一进入就放进排队区, 而排队区只在端口有流发送完毕时才取出,
+//       这些流永远不会发送; 排队区容量为 0 时缓存区溢出的流只能丢弃, 同样不是有意义的配置
+//   --mix : 端口组合, 可以给多个, base 为原来的端口; 否则为若干个 [+-]带宽[x数量], 如 +12000x2 (加两个 12000 的端口)、
+//           -3000 (去掉一个 3000 的端口)、+12000x2-3000x1; 总是包含 base
+//   --jobs : 线程数, 默认 CPU 核数
+// 所有取值的笛卡尔积为配置网格, 每个配置与 solve2 相同, 两组权重各调度一次取总时间较小的
+// 标准输出为 csv: config,buffer,queue,penalty,mix,ports,capacity,total,makespan,dropped,penalty_time,mean_wait,max_wait,seconds
+//   total 为调度自己估计的总时间 (与 solve2 的 transfer 返回值相同), makespan 为最后一个流发送完毕的时刻,
+//   penalty_time 为丢弃罚时, 等待时间为流开始发送的时刻 - 进入设备的时刻 (只统计开始发送的流), seconds 为 CPU 时间
+// 网格大小、线程数、耗时和进程的峰值内存输出到标准错误
+
+struct Config {
+	RuleSet rules;
+	string mix;
+	vector<int> bandwidths;
+};
+
+// 一个配置在调度过程中累计的指标
+struct Surface {
+	int total = 0;
+	int makespan = 0;
+	long long dropped = 0;
+	long long penalty = 0;
+	long long started = 0;
+	long long waitSum = 0;
+	int maxWait = 0;
+	double seconds = 0;
+};
+
+struct SurfaceSink {
+	Surface &surface;
+	int penalty;
+
+	void assign(const solver::Flow &, int, int) {}
+
+	void start(const solver::Flow &f, int time) {
+		int wait = time - f.startTime;
+		++surface.started;
+		surface.waitSum += wait;
+		surface.maxWait = max(surface.maxWait, wait);
+		surface.makespan = max(surface.makespan, time + f.sendTime);
+	}
+
+	void drop(const solver::Flow &f, int) {
+		++surface.dropped;
+		surface.penalty += (long long) penalty * f.sendTime;
+	}
+};
+
+// 逗号分隔的不小于 minimum 的整数
+bool parseList(const char *text, vector<int> &values, int minimum) {
+	values.clear();
+	const char *p = text;
+	while (*p != '\0') {
+		char *end;
+		long v = strtol(p, &end, 10);
+		if (end == p || v < minimum || v > INT_MAX) {
+			return false;
+		}
+		values.push_back((int) v);
+		p = *end == ',' ? end + 1 : end;
+		if (*end != ',' && *end != '\0') {
+			return false;
+		}
+	}
+	return !values.empty();
+}
+
+// 端口组合: base, 或若干个 [+-]带宽[x数量]; 去掉端口时去掉 id 最大的那个, 之后重新按顺序编号
+bool applyMix(const string &mix, const vector<int> &base, vector<int> &bandwidths) {
+	bandwidths = base;
+	if (mix == "base") {
+		return true;
+	}
+	const char *p = mix.c_str();
+	while (*p != '\0') {
+		char sign = *p;
+		if (sign != '+' && sign != '-') {
+			return false;
+		}
+		char *end;
+		long bandwidth = strtol(p + 1, &end, 10);
+		if (end == p + 1 || bandwidth <= 0) {
+			return false;
+		}
+		long count = 1;
+		if (*end == 'x') {
+			const char *q = end + 1;
+			count = strtol(q, &end, 10);
+			if (end == q || count <= 0) {
+				return false;
+			}
+		}
+		for (long k = 0; k < count; ++k) {
+			if (sign == '+') {
+				bandwidths.push_back((int) bandwidth);
+				continue;
+			}
+			auto it = find(bandwidths.rbegin(), bandwidths.rend(), (int) bandwidth);
+			if (it == bandwidths.rend()) {
+				return false;
+			}
+			bandwidths.erase(next(it).base());
+		}
+		p = end;
+	}
+	return !bandwidths.empty();
+}
+
+double threadSeconds() {
+	timespec ts{};
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+Surface evaluate(const vector<solver::Flow> &pool, const Config &config) {
+	double begin = threadSeconds();
+	Surface best;
+	best.total = INT_MAX;
+	double weights[2][2] = {{2.3, -7.9}, {0.8, 0.0}};
+	for (auto &w: weights) {
+		Surface surface;
+		SurfaceSink sink{surface, config.rules.penalty};
+		surface.total = solver::schedule(pool, config.bandwidths, sink, w[0], w[1], 0, config.rules);
+		if (surface.total < best.total) {
+			best = surface;
+		}
+	}
+	best.seconds = threadSeconds() - begin;
+	return best;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		cerr << "用法：./whatif 数据目录 [--buffer 20,40] [--queue 30,60] [--penalty 2] [--mix MIX]... [--jobs N]" << endl;
+		return 1;
+	}
+	string dir = argv[1];
+	vector<int> buffers{StandardRules::bufferFactor};
+	vector<int> queues{StandardRules::queueLimit};
+	vector<int> penalties{StandardRules::penalty};
+	vector<string> mixes{"base"};
+	int jobs = (int) thread::hardware_concurrency();
+	for (int i = 2; i < argc; ++i) {
+		bool ok = true;
+		if (strcmp(argv[i], "--buffer") == 0 && i + 1 < argc) {
+			ok = parseList(argv[++i], buffers, 1);
+		} else if (strcmp(argv[i], "--queue") == 0 && i + 1 < argc) {
+			ok = parseList(argv[++i], queues, 1);
+		} else if (strcmp(argv[i], "--penalty") == 0 && i + 1 < argc) {
+			ok = parseList(argv[++i], penalties, 0);
+		} else if (strcmp(argv[i], "--mix") == 0 && i + 1 < argc) {
+			if (strcmp(argv[++i], "base") != 0) {
+				mixes.emplace_back(argv[i]);
+			}
+		} else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+			jobs = atoi(argv[++i]);
+		} else {
+			ok = false;
+		}
+		if (!ok) {
+			cerr << "参数有误：" << argv[i] << endl;
+			return 1;
+		}
+	}
+
+	auto begin = chrono::steady_clock::now();
+	list<solver::Flow> flows;
+	vector<solver::Port> ports;
+	solver::loadFlow((dir + "/flow.txt").c_str(), flows);
+	solver::loadPort((dir + "/port.txt").c_str(), ports);
+	if (flows.empty() || ports.empty()) {
+		cerr << dir << " 中没有流或端口" << endl;
+		return 1;
+	}
+	flows.sort([](solver::Flow &first, solver::Flow &second) {
+		if (first.startTime != second.startTime) {
+			return first.startTime < second.startTime;
+		} else if (first.bandwidth != second.bandwidth) {
+			return first.bandwidth < second.bandwidth;
+		} else {
+			return first.sendTime < second.sendTime;
+		}
+	});
+	// 所有配置共用的只读流数组, 链表用完就释放
+	vector<solver::Flow> pool;
+	pool.reserve(flows.size());
+	int widestFlow = 0;
+	for (auto &f: flows) {
+		f.index = (int) pool.size();
+		pool.push_back(f);
+		widestFlow = max(widestFlow, f.bandwidth);
+	}
+	list<solver::Flow>().swap(flows);
+	vector<int> base;
+	for (const auto &port: ports) {
+		base.push_back(port.bandwidth);
+	}
+	double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+	vector<Config> grid;
+	for (const string &mix: mixes) {
+		vector<int> bandwidths;
+		if (!applyMix(mix, base, bandwidths)) {
+			cerr << "端口组合有误：" << mix << endl;
+			return 1;
+		}
+		if (*max_element(bandwidths.begin(), bandwidths.end()) < widestFlow) {
+			// 放不下最宽的流时调度不会结束
+			cerr << "端口组合 " << mix << " 中没有放得下带宽 " << widestFlow << " 的端口" << endl;
+			return 1;
+		}
+		for (int buffer: buffers) {
+			for (int queue: queues) {
+				for (int penalty: penalties) {
+					Config config;
+					config.rules.bufferFactor = buffer;
+					config.rules.queueLimit = queue;
+					config.rules.penalty = penalty;
+					config.mix = mix;
+					config.bandwidths = bandwidths;
+					grid.push_back(config);
+				}
+			}
+		}
+	}
+
+	jobs = max(1, min(jobs, (int) grid.size()));
+	vector<Surface> surfaces(grid.size());
+	atomic<int> claim{0};
+	auto work = [&]() {
+		for (int k = claim.fetch_add(1); k < (int) grid.size(); k = claim.fetch_add(1)) {
+			surfaces[k] = evaluate(pool, grid[k]);
+		}
+	};
+	auto start = chrono::steady_clock::now();
+	vector<thread> threads;
+	for (int i = 1; i < jobs; ++i) {
+		threads.emplace_back(work);
+	}
+	work();
+	for (auto &t: threads) {
+		t.join();
+	}
+	double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	printf("config,buffer,queue,penalty,mix,ports,capacity,total,makespan,dropped,penalty_time,mean_wait,max_wait,seconds\n");
+	double seconds = 0;
+	for (size_t k = 0; k < grid.size(); ++k) {
+		const Config &config = grid[k];
+		const Surface &s = surfaces[k];
+		long long capacity = 0;
+		for (int bw: config.bandwidths) {
+			capacity += bw;
+		}
+		printf("%zu,%d,%d,%d,%s,%zu,%lld,%d,%d,%lld,%lld,%.3f,%d,%.3f\n", k, config.rules.bufferFactor,
+		       config.rules.queueLimit, config.rules.penalty, config.mix.c_str(), config.bandwidths.size(), capacity,
+		       s.total, s.makespan, s.dropped, s.penalty, s.started > 0 ? (double) s.waitSum / s.started : 0.0,
+		       s.maxWait, s.seconds);
+		seconds += s.seconds;
+	}
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	fprintf(stderr, "%zu 个配置，%d 个线程，读取 %.2f 秒，计算 %.2f 秒（CPU 时间之和 %.2f 秒），"
+	                "峰值内存 %.1f MB（其中共享的流数组 %.1f MB）\n", grid.size(), jobs, loadSeconds, wall, seconds,
+	        usage.ru_maxrss / 1024.0, pool.size() * sizeof(solver::Flow) / 1048576.0);
+	return 0;
+}